@@ -0,0 +1,401 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  logger_bench - measures the throughput and latency of Logger.
+
+  Every scenario runs a number of producer threads, each logging the same
+  number of messages as fast as it can. The time of every single call is
+  recorded, and the results are written as CSV or JSON, one row per
+  scenario and thread count, so they can be compared between releases.
+  */
+#include "log/debug.h"
+#include "log/logger.h"
+#include "log/timestamp.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QDir>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+namespace {
+    /// a single call being measured.
+    typedef void (*Call)(Logger *log, const QString &message, const char *text);
+
+    void logCall(Logger *log, const QString &message, const char *)
+    {
+        log->log(INFO, message);
+    }
+
+    void logDebugCall(Logger *log, const QString &message, const char *)
+    {
+        log->log(DEBUG, message);
+    }
+
+    void macroCall(Logger *, const QString &, const char *text)
+    {
+        LOG_DEBUG("%s", text);
+    }
+
+    void messageHandlerCall(Logger *, const QString &, const char *text)
+    {
+        qWarning("%s", text);
+    }
+
+    void messageHandlerDebugCall(Logger *, const QString &, const char *text)
+    {
+        qDebug("%s", text);
+    }
+
+    void scopeCall(Logger *, const QString &, const char *)
+    {
+        Debug::Scope scope("benchmark scope");
+    }
+
+    /**
+      Holds the producers back until all of them have started.
+      */
+    class StartGate {
+    public:
+        StartGate()
+            : m_open(false)
+        {
+        }
+
+        void wait()
+        {
+            QMutexLocker locker(&m_mutex);
+            while(!m_open)
+                m_condition.wait(&m_mutex);
+        }
+
+        void open()
+        {
+            QMutexLocker locker(&m_mutex);
+            m_open = true;
+            m_condition.wakeAll();
+        }
+
+    private:
+        QMutex m_mutex;
+        QWaitCondition m_condition;
+        bool m_open;
+    };
+
+    /**
+      A thread making the call a number of times, timing each call.
+      */
+    class Producer : public QThread {
+    public:
+        Producer(StartGate *gate, Call call, const QString &message, int messages)
+            : m_gate(gate), m_call(call), m_message(message), m_text(message.toLatin1()),
+              m_latencies(messages)
+        {
+        }
+
+        /// the time taken by each call, in nanoseconds.
+        const QVector<qint64> &latencies() const
+        {
+            return m_latencies;
+        }
+
+    protected:
+        void run()
+        {
+            Logger *log = Logger::instance();
+            const char *text = m_text.constData();
+            qint64 *latency = m_latencies.data();
+            int count = m_latencies.size();
+
+            m_gate->wait();
+            for(int i = 0; i < count; i++) {
+                qint64 start = Timestamp::now();
+                m_call(log, m_message, text);
+                latency[i] = Timestamp::now() - start;
+            }
+        }
+
+    private:
+        StartGate *m_gate;
+        Call m_call;
+        QString m_message;
+        QByteArray m_text;
+        QVector<qint64> m_latencies;
+    };
+
+    /**
+      How the Logger is set up for a scenario.
+      */
+    struct Setup {
+        Setup()
+            : threshold(DEBUG), console(false), asynchronous(false), bufferSize(0)
+        {
+        }
+
+        LogLevel threshold;
+        bool console;
+        bool asynchronous;
+        int bufferSize;
+    };
+
+    /**
+      The outcome of a single run.
+      */
+    struct Result {
+        QByteArray scenario;
+        int threads;
+        int messageSize;
+        qint64 messages;
+        double seconds;
+        double messagesPerSecond;
+        qint64 p50;
+        qint64 p99;
+        qint64 p999;
+    };
+
+    qint64 percentile(const QVector<qint64> &sorted, double fraction)
+    {
+        if(sorted.isEmpty())
+            return 0;
+        int index = qMin(sorted.size() - 1, int(sorted.size() * fraction));
+        return sorted.at(index);
+    }
+
+    Result run(const char *scenario, const Setup &setup, Call call, int threads,
+               int messageSize, int messages)
+    {
+        Logger *log = Logger::instance();
+        log->setLogThreshold(setup.threshold);
+        log->setLogToConsole(setup.console);
+        log->setBufferSize(setup.bufferSize);
+        log->setAsynchronous(setup.asynchronous);
+
+        QString message(messageSize, QChar('x'));
+        StartGate gate;
+        QList<Producer *> producers;
+        for(int i = 0; i < threads; i++) {
+            producers.append(new Producer(&gate, call, message, messages));
+            producers.last()->start();
+        }
+
+        qint64 start = Timestamp::now();
+        gate.open();
+        for(int i = 0; i < producers.size(); i++)
+            producers.at(i)->wait();
+        // the output is not written until the buffers and queue are empty
+        log->flush();
+        log->setAsynchronous(false);
+        qint64 elapsed = Timestamp::now() - start;
+
+        QVector<qint64> latencies;
+        latencies.reserve(threads * messages);
+        for(int i = 0; i < producers.size(); i++) {
+            latencies += producers.at(i)->latencies();
+            delete producers.at(i);
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        Result result;
+        result.scenario = scenario;
+        result.threads = threads;
+        result.messageSize = messageSize;
+        result.messages = qint64(threads) * messages;
+        result.seconds = elapsed / 1e9;
+        result.messagesPerSecond = result.seconds > 0 ? result.messages / result.seconds : 0;
+        result.p50 = percentile(latencies, 0.5);
+        result.p99 = percentile(latencies, 0.99);
+        result.p999 = percentile(latencies, 0.999);
+        return result;
+    }
+
+    void writeCsv(FILE *out, const QList<Result> &results)
+    {
+        fprintf(out, "scenario,threads,message_size,messages,seconds,messages_per_sec,p50_ns,p99_ns,p999_ns\n");
+        for(int i = 0; i < results.size(); i++) {
+            const Result &r = results.at(i);
+            fprintf(out, "%s,%d,%d,%lld,%.6f,%.0f,%lld,%lld,%lld\n",
+                    r.scenario.constData(), r.threads, r.messageSize, (long long)r.messages,
+                    r.seconds, r.messagesPerSecond,
+                    (long long)r.p50, (long long)r.p99, (long long)r.p999);
+        }
+    }
+
+    void writeJson(FILE *out, const QList<Result> &results)
+    {
+        fprintf(out, "[\n");
+        for(int i = 0; i < results.size(); i++) {
+            const Result &r = results.at(i);
+            fprintf(out, "  {\"scenario\": \"%s\", \"threads\": %d, \"message_size\": %d, "
+                    "\"messages\": %lld, \"seconds\": %.6f, \"messages_per_sec\": %.0f, "
+                    "\"p50_ns\": %lld, \"p99_ns\": %lld, \"p999_ns\": %lld}%s\n",
+                    r.scenario.constData(), r.threads, r.messageSize, (long long)r.messages,
+                    r.seconds, r.messagesPerSecond,
+                    (long long)r.p50, (long long)r.p99, (long long)r.p999,
+                    i + 1 < results.size() ? "," : "");
+        }
+        fprintf(out, "]\n");
+    }
+
+    void usage()
+    {
+        fprintf(stderr,
+                "Usage: logger_bench [options]\n"
+                "Measures the throughput and per-call latency of Logger.\n"
+                "\n"
+                "Options:\n"
+                "  -n, --messages N     messages logged by each thread (default 100000)\n"
+                "  -t, --threads N      largest number of producer threads (default: one per core)\n"
+                "  -f, --format FORMAT  csv or json (default csv)\n"
+                "  -o, --output FILE    write the results to FILE rather than stdout\n"
+                "  -d, --dir PATH       directory to write the log file in (default: temp dir)\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    // keep the settings apart from those of real applications
+    QCoreApplication::setOrganizationName("Logger");
+    QCoreApplication::setApplicationName("Logger bench");
+
+    int messages = 100000;
+    int maxThreads = qMax(1, QThread::idealThreadCount());
+    bool json = false;
+    const char *outputPath = 0;
+    QString dir = QDir::tempPath();
+
+    for(int i = 1; i < argc; i++) {
+        QByteArray arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if((arg == "-n" || arg == "--messages") && hasValue) {
+            messages = QByteArray(argv[++i]).toInt();
+        }
+        else if((arg == "-t" || arg == "--threads") && hasValue) {
+            maxThreads = QByteArray(argv[++i]).toInt();
+        }
+        else if((arg == "-f" || arg == "--format") && hasValue) {
+            QByteArray format(argv[++i]);
+            if(format != "csv" && format != "json") {
+                usage();
+                return 1;
+            }
+            json = format == "json";
+        }
+        else if((arg == "-o" || arg == "--output") && hasValue) {
+            outputPath = argv[++i];
+        }
+        else if((arg == "-d" || arg == "--dir") && hasValue) {
+            dir = QString::fromLocal8Bit(argv[++i]);
+        }
+        else if(arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+    if(messages <= 0 || maxThreads <= 0) {
+        usage();
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if(outputPath) {
+        out = fopen(outputPath, "w");
+        if(!out) {
+            fprintf(stderr, "logger_bench: could not open %s\n", outputPath);
+            return 1;
+        }
+    }
+
+    // console output goes to the null device, so the terminal is not what we measure
+#ifdef Q_OS_WIN
+    if(!freopen("NUL", "w", stderr))
+#else
+    if(!freopen("/dev/null", "w", stderr))
+#endif
+        return 1;
+
+    Logger *log = Logger::instance();
+    log->setLogPath(dir, "logger_bench.log");
+    log->setLogFormat(TEXT_FORMAT);
+    log->setLogLimit(0);
+    log->setLogMaxSize(0);
+
+    QList<Result> results;
+    Setup file;
+    Setup disabled;
+    disabled.threshold = WARNING;
+    Setup console;
+    console.console = true;
+    Setup asynchronous;
+    asynchronous.asynchronous = true;
+    Setup buffered;
+    buffered.bufferSize = 64 * 1024;
+    const int messageSize = 64;
+
+    // the cost of a message which is filtered out
+    results += run("disabled_macro", disabled, macroCall, 1, messageSize, messages);
+    results += run("disabled_log", disabled, logDebugCall, 1, messageSize, messages);
+    results += run("disabled_message_handler", disabled, messageHandlerDebugCall, 1, messageSize, messages);
+
+    // the entry points, from a single thread
+    results += run("message_handler", file, messageHandlerCall, 1, messageSize, messages);
+    results += run("scope", file, scopeCall, 1, messageSize, messages);
+    results += run("console", console, logCall, 1, messageSize, messages);
+
+    // contention, with every way of writing the file
+    for(int threads = 1; ; threads = qMin(threads * 2, maxThreads)) {
+        results += run("file", file, logCall, threads, messageSize, messages);
+        results += run("asynchronous", asynchronous, logCall, threads, messageSize, messages);
+        results += run("buffered", buffered, logCall, threads, messageSize, messages);
+        if(threads == maxThreads)
+            break;
+    }
+
+    // the message size
+    for(int size = 16; size <= 4096; size *= 4)
+        results += run("message_size", file, logCall, 1, size, messages);
+
+    log->close();
+    QFile::remove(dir + QDir::separator() + "logger_bench.log");
+
+    if(json)
+        writeJson(out, results);
+    else
+        writeCsv(out, results);
+    if(out != stdout)
+        fclose(out);
+
+    return 0;
+}
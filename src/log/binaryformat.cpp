@@ -0,0 +1,462 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of the BinaryLog namespace.
+  */
+#include "binaryformat.h"
+#include "logrecord.h"
+
+#include <cstring>
+
+namespace {
+    /// the kind of argument a printf conversion consumes.
+    enum ArgumentKind {
+        SignedArgument,
+        UnsignedArgument,
+        DoubleArgument,
+        StringArgument,
+        PointerArgument,
+        NoArgument,
+        InvalidArgument
+    };
+
+    /// the parts of a single printf conversion specification.
+    struct Conversion {
+        /// the flags, e.g. "-0".
+        const char *flags;
+        int flagsLength;
+        /// the width digits, if not given as an argument.
+        const char *width;
+        int widthLength;
+        bool widthArgument;
+        /// the precision digits, if not given as an argument.
+        bool hasPrecision;
+        const char *precision;
+        int precisionLength;
+        bool precisionArgument;
+        /// the length modifier, e.g. "ll".
+        const char *length;
+        int lengthLength;
+        /// the conversion character, e.g. 'd'.
+        char conversion;
+        /// one past the end of the specification.
+        const char *end;
+    };
+
+    bool isFlag(char c)
+    {
+        return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0' || c == '\'';
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /**
+      Parses the conversion specification starting at the '%' at p.
+      @return false if the specification is incomplete.
+      */
+    bool parseConversion(const char *p, Conversion &c)
+    {
+        ++p;
+        c.flags = p;
+        while(isFlag(*p))
+            ++p;
+        c.flagsLength = p - c.flags;
+
+        c.widthArgument = (*p == '*');
+        c.width = p;
+        if(c.widthArgument)
+            ++p;
+        else
+            while(isDigit(*p))
+                ++p;
+        c.widthLength = c.widthArgument ? 0 : p - c.width;
+
+        c.hasPrecision = (*p == '.');
+        c.precisionArgument = false;
+        c.precision = p;
+        c.precisionLength = 0;
+        if(c.hasPrecision) {
+            ++p;
+            c.precisionArgument = (*p == '*');
+            c.precision = p;
+            if(c.precisionArgument)
+                ++p;
+            else
+                while(isDigit(*p))
+                    ++p;
+            c.precisionLength = c.precisionArgument ? 0 : p - c.precision;
+        }
+
+        c.length = p;
+        if((p[0] == 'h' && p[1] == 'h') || (p[0] == 'l' && p[1] == 'l'))
+            p += 2;
+        else if(*p == 'h' || *p == 'l' || *p == 'L' || *p == 'q' || *p == 'j' || *p == 'z' || *p == 't')
+            ++p;
+        c.lengthLength = p - c.length;
+
+        c.conversion = *p;
+        if(!c.conversion)
+            return false;
+        c.end = p + 1;
+        return true;
+    }
+
+    ArgumentKind argumentKind(char conversion)
+    {
+        switch(conversion) {
+        case 'd': case 'i': case 'c':
+            return SignedArgument;
+        case 'u': case 'o': case 'x': case 'X':
+            return UnsignedArgument;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            return DoubleArgument;
+        case 's':
+            return StringArgument;
+        case 'p':
+            return PointerArgument;
+        case '%':
+            return NoArgument;
+        default:
+            // %n, and anything we do not know
+            return InvalidArgument;
+        }
+    }
+
+    bool hasLength(const Conversion &c, const char *length)
+    {
+        return c.lengthLength == int(qstrlen(length)) && !strncmp(c.length, length, c.lengthLength);
+    }
+
+    template<typename T>
+    void appendValue(QByteArray &out, T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    bool readValue(const char *&args, const char *end, T &value)
+    {
+        if(end - args < qptrdiff(sizeof(value)))
+            return false;
+        memcpy(&value, args, sizeof(value));
+        args += sizeof(value);
+        return true;
+    }
+
+    template<typename T>
+    void appendFormatted(QByteArray &out, const char *spec, T value)
+    {
+        char buffer[128];
+        int length = qsnprintf(buffer, sizeof(buffer), spec, value);
+        if(length < 0)
+            return;
+        if(length < int(sizeof(buffer))) {
+            out.append(buffer, length);
+            return;
+        }
+        // too large for the stack, e.g. a very wide field
+        QByteArray large(length + 1, '\0');
+        qsnprintf(large.data(), length + 1, spec, value);
+        out.append(large.constData(), length);
+    }
+
+    /**
+      Appends a number to a specification being rebuilt.
+      */
+    char *appendNumber(char *spec, qint64 value)
+    {
+        return spec + qsnprintf(spec, 24, "%lld", value);
+    }
+
+    QByteArray encodeHeader(const LogRecord &record, BinaryLog::RecordType type, quint32 formatId)
+    {
+        BinaryLog::RecordHeader header;
+        header.size = sizeof(header);
+        header.formatId = formatId;
+        header.time = record.time;
+        header.thread = record.thread;
+        header.type = type;
+        header.level = record.level;
+        header.indent = record.indent;
+        header.reserved = 0;
+        return QByteArray(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    void updateSize(QByteArray &encoded)
+    {
+        quint32 size = encoded.size();
+        memcpy(encoded.data(), &size, sizeof(size));
+    }
+}
+
+namespace BinaryLog
+{
+    FileHeader fileHeader()
+    {
+        FileHeader header;
+        memcpy(header.magic, "LOGBIN\n", sizeof(header.magic));
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.version = VERSION;
+        return header;
+    }
+
+    bool isValid(const char *header, qint64 size)
+    {
+        FileHeader expected = fileHeader();
+        if(size < qint64(sizeof(expected)))
+            return false;
+        FileHeader actual;
+        memcpy(&actual, header, sizeof(actual));
+        return !memcmp(actual.magic, expected.magic, sizeof(actual.magic))
+                && actual.byteOrder == BYTE_ORDER_MARK && actual.version == VERSION;
+    }
+
+    QByteArray encodeMessage(const LogRecord &record)
+    {
+        QByteArray encoded = encodeHeader(record, MessageRecord, 0);
+        encoded.append(record.message.toUtf8());
+        if(!record.fields.isEmpty()) {
+            encoded.append(" {");
+            encoded.append(record.fields);
+            encoded.append('}');
+        }
+        updateSize(encoded);
+        return encoded;
+    }
+
+    QByteArray encodeMessage(const LogRecord &record, quint32 formatId, const char *format, va_list ap)
+    {
+        QByteArray encoded = encodeHeader(record, MessageRecord, formatId);
+        appendArguments(encoded, format, ap);
+        updateSize(encoded);
+        return encoded;
+    }
+
+    QByteArray encodeFormat(quint32 formatId, const char *format)
+    {
+        LogRecord record;
+        QByteArray encoded = encodeHeader(record, FormatRecord, formatId);
+        encoded.append(format);
+        updateSize(encoded);
+        return encoded;
+    }
+
+    void appendArguments(QByteArray &out, const char *format, va_list ap)
+    {
+        Conversion c;
+        for(const char *p = format; *p; ++p) {
+            if(*p != '%')
+                continue;
+            if(!parseConversion(p, c))
+                return;
+            p = c.end - 1;
+
+            ArgumentKind kind = argumentKind(c.conversion);
+            if(kind == InvalidArgument)
+                return;
+            if(kind == NoArgument)
+                continue;
+
+            if(c.widthArgument)
+                appendValue(out, qint64(va_arg(ap, int)));
+            int precision = -1;
+            if(c.precisionArgument) {
+                precision = va_arg(ap, int);
+                appendValue(out, qint64(precision));
+            }
+            else if(c.hasPrecision) {
+                precision = QByteArray(c.precision, c.precisionLength).toInt();
+            }
+
+            switch(kind) {
+            case SignedArgument:
+                if(hasLength(c, "hh"))
+                    appendValue(out, qint64((signed char)va_arg(ap, int)));
+                else if(hasLength(c, "h"))
+                    appendValue(out, qint64((short)va_arg(ap, int)));
+                else if(hasLength(c, "l"))
+                    appendValue(out, qint64(va_arg(ap, long)));
+                else if(hasLength(c, "ll") || hasLength(c, "q") || hasLength(c, "j"))
+                    appendValue(out, qint64(va_arg(ap, long long)));
+                else if(hasLength(c, "z") || hasLength(c, "t"))
+                    appendValue(out, qint64(va_arg(ap, qptrdiff)));
+                else
+                    appendValue(out, qint64(va_arg(ap, int)));
+                break;
+            case UnsignedArgument:
+                if(hasLength(c, "hh"))
+                    appendValue(out, quint64((unsigned char)va_arg(ap, unsigned int)));
+                else if(hasLength(c, "h"))
+                    appendValue(out, quint64((unsigned short)va_arg(ap, unsigned int)));
+                else if(hasLength(c, "l"))
+                    appendValue(out, quint64(va_arg(ap, unsigned long)));
+                else if(hasLength(c, "ll") || hasLength(c, "q") || hasLength(c, "j"))
+                    appendValue(out, quint64(va_arg(ap, unsigned long long)));
+                else if(hasLength(c, "z") || hasLength(c, "t"))
+                    appendValue(out, quint64(va_arg(ap, size_t)));
+                else
+                    appendValue(out, quint64(va_arg(ap, unsigned int)));
+                break;
+            case DoubleArgument:
+                if(hasLength(c, "L"))
+                    appendValue(out, double(va_arg(ap, long double)));
+                else
+                    appendValue(out, va_arg(ap, double));
+                break;
+            case StringArgument: {
+                const char *str = va_arg(ap, const char *);
+                if(!str)
+                    str = "(null)";
+                // with a precision, the string need not be terminated
+                quint32 length = 0;
+                while(str[length] && (precision < 0 || length < quint32(precision)))
+                    ++length;
+                appendValue(out, length);
+                out.append(str, length);
+                break;
+            }
+            case PointerArgument:
+                appendValue(out, quint64(quintptr(va_arg(ap, void *))));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    QByteArray formatArguments(const char *format, const char *args, int size)
+    {
+        QByteArray out;
+        const char *end = args + size;
+        const char *text = format;
+        Conversion c;
+        // room for "%", the flags, two numbers, "ll" and the conversion.
+        char spec[96];
+
+        for(const char *p = format; *p; ++p) {
+            if(*p != '%')
+                continue;
+            out.append(text, p - text);
+            if(!parseConversion(p, c))
+                return out;
+            p = c.end - 1;
+            text = c.end;
+
+            ArgumentKind kind = argumentKind(c.conversion);
+            if(kind == InvalidArgument)
+                return out;
+            if(kind == NoArgument) {
+                out.append('%');
+                continue;
+            }
+            if(c.flagsLength > 8 || c.widthLength > 16 || c.precisionLength > 16)
+                return out;
+
+            // rebuild the specification with the arguments of '*' filled in
+            // and the length modifier matching what we stored.
+            char *s = spec;
+            *s++ = '%';
+            memcpy(s, c.flags, c.flagsLength);
+            s += c.flagsLength;
+            qint64 value = 0;
+            if(c.widthArgument) {
+                if(!readValue(args, end, value))
+                    return out;
+                s = appendNumber(s, value);
+            }
+            else {
+                memcpy(s, c.width, c.widthLength);
+                s += c.widthLength;
+            }
+            if(c.hasPrecision) {
+                *s++ = '.';
+                if(c.precisionArgument) {
+                    if(!readValue(args, end, value))
+                        return out;
+                    s = appendNumber(s, value);
+                }
+                else {
+                    memcpy(s, c.precision, c.precisionLength);
+                    s += c.precisionLength;
+                }
+            }
+            if((kind == SignedArgument || kind == UnsignedArgument) && c.conversion != 'c') {
+                *s++ = 'l';
+                *s++ = 'l';
+            }
+            *s++ = c.conversion;
+            *s = '\0';
+
+            switch(kind) {
+            case SignedArgument: {
+                qint64 number;
+                if(!readValue(args, end, number))
+                    return out;
+                if(c.conversion == 'c')
+                    appendFormatted(out, spec, int(number));
+                else
+                    appendFormatted(out, spec, (long long)number);
+                break;
+            }
+            case UnsignedArgument: {
+                quint64 number;
+                if(!readValue(args, end, number))
+                    return out;
+                appendFormatted(out, spec, (unsigned long long)number);
+                break;
+            }
+            case DoubleArgument: {
+                double number;
+                if(!readValue(args, end, number))
+                    return out;
+                appendFormatted(out, spec, number);
+                break;
+            }
+            case StringArgument: {
+                quint32 length;
+                if(!readValue(args, end, length) || end - args < qptrdiff(length))
+                    return out;
+                // copy, as the stored string is not terminated
+                QByteArray str(args, length);
+                args += length;
+                appendFormatted(out, spec, str.constData());
+                break;
+            }
+            case PointerArgument: {
+                quint64 pointer;
+                if(!readValue(args, end, pointer))
+                    return out;
+                appendFormatted(out, spec, (void *)quintptr(pointer));
+                break;
+            }
+            default:
+                break;
+            }
+        }
+
+        out.append(text);
+        return out;
+    }
+}
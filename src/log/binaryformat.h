@@ -0,0 +1,151 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of the BinaryLog namespace, describing the binary log format.
+
+  A binary log starts with a FileHeader, followed by a sequence of records.
+  Every record starts with a RecordHeader and is followed by a payload:
+  - a FormatRecord defines a format string. Its payload is the format string
+    itself, and the format id in the header is the id messages will use to
+    refer to it. Definitions always precede the messages using them.
+  - a MessageRecord is a message. If its format id is zero, the payload is the
+    message as UTF-8 text, followed by its fields in braces if it has any.
+    Otherwise the payload holds the raw arguments for the format string
+    with that id, as written by appendArguments().
+  All values are in the byte order of the machine that wrote the log; the
+  FileHeader lets a reader check that it matches its own.
+  */
+
+#ifndef BINARYFORMAT_H
+#define BINARYFORMAT_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include <cstdarg>
+
+#include "export.h"
+
+struct LogRecord;
+
+/**
+  A namespace for reading and writing the binary log format.
+  */
+namespace BinaryLog
+{
+    /// the value of FileHeader::byteOrder when read in the byte order it was written in.
+    const quint32 BYTE_ORDER_MARK = 0x01020304;
+    /// the current version of the format.
+    const quint32 VERSION = 2;
+
+    /**
+      The header at the start of every binary log.
+      */
+    struct FileHeader {
+        /// always "LOGBIN\n" followed by a NUL.
+        char magic[8];
+        /// BYTE_ORDER_MARK, in the byte order of the writer.
+        quint32 byteOrder;
+        /// the version of the format.
+        quint32 version;
+    };
+
+    /**
+      The different kinds of records in a binary log.
+      */
+    enum RecordType {
+        MessageRecord = 0,
+        FormatRecord = 1
+    };
+
+    /**
+      The fixed-size header of every record.
+      */
+    struct RecordHeader {
+        /// the size of the record, including this header.
+        quint32 size;
+        /// the format string used by the message, or zero for literal messages.
+        quint32 formatId;
+        /// when the message was logged, in nanoseconds since the epoch.
+        qint64 time;
+        /// the thread the message was logged from.
+        quint64 thread;
+        /// the RecordType.
+        quint8 type;
+        /// the LogLevel of the message.
+        quint8 level;
+        /// the indentation of the message.
+        quint16 indent;
+        /// unused, always zero.
+        quint32 reserved;
+    };
+
+    /**
+      Returns a FileHeader for the machine we are running on.
+      */
+    LOGGER_EXPORT FileHeader fileHeader();
+    /**
+      Does the given header start a binary log we can read?
+      @param header the header to check.
+      @param size the number of bytes available at header.
+      */
+    LOGGER_EXPORT bool isValid(const char *header, qint64 size);
+
+    /**
+      Encodes a message record holding the message of the given record as text.
+      */
+    LOGGER_EXPORT QByteArray encodeMessage(const LogRecord &record);
+    /**
+      Encodes a message record holding the raw arguments for the given format.
+      @param record the record supplying the level, time, thread and indent.
+      @param formatId the id the format string was defined with.
+      @param format the printf-style format string.
+      @param ap the arguments to the format string.
+      */
+    LOGGER_EXPORT QByteArray encodeMessage(const LogRecord &record, quint32 formatId,
+                                           const char *format, va_list ap);
+    /**
+      Encodes a record defining a format string.
+      */
+    LOGGER_EXPORT QByteArray encodeFormat(quint32 formatId, const char *format);
+
+    /**
+      Appends the raw bytes of the arguments consumed by a printf-style format.
+      Integers and pointers are stored as 64 bit values, floating point values
+      as doubles, and strings as a 32 bit length followed by the characters.
+      Conversions that cannot be stored (%n) end the encoding.
+      @param out the array to append to.
+      @param format the printf-style format string.
+      @param ap the arguments to the format string.
+      */
+    LOGGER_EXPORT void appendArguments(QByteArray &out, const char *format, va_list ap);
+    /**
+      Formats a message from a format string and arguments stored by appendArguments().
+      @param format the printf-style format string.
+      @param args the stored arguments.
+      @param size the number of bytes at args.
+      @return the formatted message.
+      */
+    LOGGER_EXPORT QByteArray formatArguments(const char *format, const char *args, int size);
+}
+
+#endif // BINARYFORMAT_H
@@ -0,0 +1,74 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of ConfigWatcher.
+  */
+#include "configwatcher.h"
+#include "logger.h"
+
+#include <QFileInfo>
+#include <QMutexLocker>
+
+ConfigWatcher::ConfigWatcher(Logger *logger, const QString &fileName, int interval)
+    : m_logger(logger), m_fileName(fileName), m_interval(interval), m_stopping(false)
+{
+}
+
+ConfigWatcher::~ConfigWatcher()
+{
+    stop();
+}
+
+void ConfigWatcher::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    wait();
+}
+
+void ConfigWatcher::run()
+{
+    QFileInfo info(m_fileName);
+    QDateTime modified = info.lastModified();
+    qint64 size = info.size();
+
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            if(!m_stopping)
+                m_wake.wait(&m_mutex, m_interval);
+            if(m_stopping)
+                break;
+        }
+
+        // the modification time may only have a resolution of a second,
+        // so a change of size counts as well.
+        info.refresh();
+        if(info.lastModified() != modified || info.size() != size) {
+            modified = info.lastModified();
+            size = info.size();
+            m_logger->reloadSettings();
+        }
+    }
+}
@@ -0,0 +1,84 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of ConfigWatcher, the thread reloading the settings when they change.
+  */
+
+#ifndef CONFIGWATCHER_H
+#define CONFIGWATCHER_H
+
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+class Logger;
+
+/**
+  A thread which checks the settings file for changes at a fixed interval,
+  and has the Logger reload its settings when the file has changed.
+  Polling, rather than waiting for a signal, means the Logger needs neither
+  to be a QObject nor an event loop in the application.
+  */
+class ConfigWatcher : public QThread
+{
+public:
+    /**
+      Constructor.
+      @param logger the Logger to reload the settings of.
+      @param fileName the settings file to watch.
+      @param interval how often to check the file, in ms.
+      */
+    ConfigWatcher(Logger *logger, const QString &fileName, int interval);
+    /**
+      Destructor.
+      Stops the thread.
+      */
+    ~ConfigWatcher();
+
+    /**
+      Stops the thread, and returns once it has finished.
+      */
+    void stop();
+
+protected:
+    /**
+      The main loop of the watcher thread.
+      */
+    void run();
+
+private:
+    /// the logger to reload the settings of.
+    Logger *m_logger;
+    /// the settings file.
+    QString m_fileName;
+    /// how often to check the file, in ms.
+    int m_interval;
+    /// protects the stop flag.
+    QMutex m_mutex;
+    /// signalled when we are asked to stop.
+    QWaitCondition m_wake;
+    /// set when the thread should exit.
+    bool m_stopping;
+};
+
+#endif // CONFIGWATCHER_H
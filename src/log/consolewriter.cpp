@@ -0,0 +1,132 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of ConsoleWriter.
+  */
+#include "consolewriter.h"
+
+#include <QTextCodec>
+
+#include <cstring>
+#include <iostream>
+
+#if defined(Q_OS_UNIX)
+#   include <cerrno>
+#   include <climits>
+#   include <sys/uio.h>
+#   include <unistd.h>
+#endif
+
+namespace {
+    //                                 Grey          White      Brown         Red
+    const char *const colors[4] = { "\x1b[01;30m", "\x1b[1m", "\x1b[00;33m", "\x1b[01;31m" };
+    const char reset[] = "\x1b[00;39m";
+    /// the MIB enum of UTF-8, see QTextCodec::mibEnum().
+    const int UTF8_MIB = 106;
+}
+
+ConsoleWriter::ConsoleWriter()
+    : m_colored(false), m_localUtf8(false), m_queued(0)
+{
+#ifdef Q_OS_LINUX
+    m_colored = !qgetenv("LOG_COLOR").isEmpty();
+#endif
+    QTextCodec *codec = QTextCodec::codecForLocale();
+    m_localUtf8 = codec && codec->mibEnum() == UTF8_MIB;
+}
+
+ConsoleWriter::~ConsoleWriter()
+{
+    flush();
+}
+
+QByteArray ConsoleWriter::decorate(LogLevel level, const QString &text, const QByteArray &local) const
+{
+    QByteArray utf8 = m_localUtf8 && !local.isNull() ? local : text.toUtf8();
+    if(!m_colored || level < DEBUG || level > CRITICAL)
+        return utf8;
+
+    int colorLength = int(strlen(colors[level]));
+    QByteArray output;
+    output.reserve(colorLength + utf8.size() + int(sizeof(reset)) - 1);
+    output.append(colors[level], colorLength);
+    output.append(utf8);
+    output.append(reset, int(sizeof(reset)) - 1);
+    return output;
+}
+
+void ConsoleWriter::write(const QByteArray &data)
+{
+    if(data.isEmpty())
+        return;
+
+    if(m_queued == MAX_BATCH)
+        flush();
+    m_queue[m_queued++] = data;
+}
+
+void ConsoleWriter::flush()
+{
+    if(!m_queued)
+        return;
+
+#if defined(Q_OS_UNIX)
+    struct iovec vectors[MAX_BATCH];
+    for(int i = 0; i < m_queued; i++) {
+        vectors[i].iov_base = const_cast<char *>(m_queue[i].constData());
+        vectors[i].iov_len = m_queue[i].size();
+    }
+#ifdef IOV_MAX
+    const int maxVectors = qMin(int(IOV_MAX), int(MAX_BATCH));
+#else
+    const int maxVectors = MAX_BATCH;
+#endif
+
+    struct iovec *first = vectors;
+    int left = m_queued;
+    while(left > 0) {
+        ssize_t written = ::writev(STDERR_FILENO, first, qMin(left, maxVectors));
+        if(written < 0 && errno == EINTR)
+            continue;
+        if(written <= 0)
+            break;
+
+        // skip what has been written, which may end within a line.
+        while(left > 0 && size_t(written) >= first->iov_len) {
+            written -= first->iov_len;
+            ++first;
+            --left;
+        }
+        if(left > 0) {
+            first->iov_base = static_cast<char *>(first->iov_base) + written;
+            first->iov_len -= written;
+        }
+    }
+#else
+    for(int i = 0; i < m_queued; i++)
+        std::cerr.write(m_queue[i].constData(), m_queue[i].size());
+#endif
+
+    // let go of the output, which may be shared with the log file's.
+    for(int i = 0; i < m_queued; i++)
+        m_queue[i] = QByteArray();
+    m_queued = 0;
+}
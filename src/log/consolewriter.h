@@ -0,0 +1,94 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of ConsoleWriter, which writes log output to standard error.
+  */
+
+#ifndef CONSOLEWRITER_H
+#define CONSOLEWRITER_H
+
+#include <QByteArray>
+#include <QString>
+
+// for LogLevel
+#include "logger.h"
+
+/**
+  Writes log output to standard error.
+  Whether to colour the output, and whether the locale's encoding is
+  UTF-8, is decided once when the writer is created rather than for
+  every message. The colour codes are kept as ready-made bytes.
+  Lines written are only queued, and the queue is written with a single
+  writev() when it is full or flushed, so a batch of messages costs one
+  system call rather than one per message.
+  The caller must serialise the use of a writer; the Logger does so with
+  the operational mutex.
+  */
+class ConsoleWriter
+{
+public:
+    /**
+      Constructor.
+      Output is coloured on Linux if the LOG_COLOR environment variable is set.
+      */
+    ConsoleWriter();
+    /**
+      Destructor.
+      Writes what is still queued.
+      */
+    ~ConsoleWriter();
+
+    /**
+      Turns a line of the text format into console output.
+      @param level the level of the message, which decides its colour.
+      @param text the line, including the newline.
+      @param local the same line in the locale's encoding, if it has been
+      encoded already, so it is used as it is if that encoding is UTF-8.
+      @returns the line as UTF-8, coloured if the output is coloured.
+      */
+    QByteArray decorate(LogLevel level, const QString &text, const QByteArray &local) const;
+
+    /**
+      Queues output to be written, writing the queue first if it is full.
+      @param data the output. It is shared, not copied.
+      */
+    void write(const QByteArray &data);
+
+    /**
+      Writes the queued output.
+      */
+    void flush();
+
+private:
+    /// the most lines written by a single system call.
+    static const int MAX_BATCH = 64;
+
+    /// is the output coloured?
+    bool m_colored;
+    /// is the locale's encoding UTF-8?
+    bool m_localUtf8;
+    /// the output waiting to be written.
+    QByteArray m_queue[MAX_BATCH];
+    /// the number of entries in m_queue.
+    int m_queued;
+};
+
+#endif // CONSOLEWRITER_H
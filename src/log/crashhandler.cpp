@@ -0,0 +1,127 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of CrashHandler.
+  */
+#include "crashhandler.h"
+#include "logbuffer.h"
+
+#include <QtGlobal>
+
+#include <csignal>
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#   include <unistd.h>
+#endif
+
+namespace {
+    /// the descriptor of the log file, read by the signal handler.
+    volatile sig_atomic_t logFileDescriptor = -1;
+    /// is the handler installed?
+    bool installed = false;
+
+#if defined(Q_OS_UNIX)
+    /// the signals a crashing process receives.
+    const int fatalSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+    const int numFatalSignals = sizeof(fatalSignals) / sizeof(fatalSignals[0]);
+    /// the handlers we replaced, in the order of fatalSignals.
+    struct sigaction previousActions[numFatalSignals];
+    /// the stack the handler runs on, as a stack overflow leaves none to spare.
+    /// Comfortably above MINSIGSTKSZ, which is not a constant everywhere.
+    char alternateStack[64 * 1024];
+    /// the alternate stack we replaced.
+    stack_t previousStack;
+#endif
+}
+
+bool CrashHandler::install()
+{
+#if defined(Q_OS_UNIX)
+    if(installed)
+        return true;
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = CrashHandler::handle;
+    sigemptyset(&action.sa_mask);
+    // a crash while saving the output should not loop back in here,
+    // and a stack overflow should not keep the handler from running.
+    action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+
+    // the alternate stack belongs to the installing thread, normally the main thread.
+    stack_t stack;
+    memset(&stack, 0, sizeof(stack));
+    stack.ss_sp = alternateStack;
+    stack.ss_size = sizeof(alternateStack);
+    sigaltstack(&stack, &previousStack);
+
+    for(int i = 0; i < numFatalSignals; i++)
+        sigaction(fatalSignals[i], &action, &previousActions[i]);
+
+    installed = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+void CrashHandler::uninstall()
+{
+#if defined(Q_OS_UNIX)
+    if(!installed)
+        return;
+
+    for(int i = 0; i < numFatalSignals; i++)
+        sigaction(fatalSignals[i], &previousActions[i], 0);
+    sigaltstack(&previousStack, 0);
+
+    installed = false;
+#endif
+}
+
+bool CrashHandler::isInstalled()
+{
+    return installed;
+}
+
+void CrashHandler::setLogFile(int fd)
+{
+    logFileDescriptor = fd;
+}
+
+void CrashHandler::handle(int signal)
+{
+#if defined(Q_OS_UNIX)
+    LogBuffer::writeUnsafe(logFileDescriptor, STDERR_FILENO);
+
+    // hand the signal on to whoever handled it before us
+    for(int i = 0; i < numFatalSignals; i++) {
+        if(fatalSignals[i] == signal) {
+            sigaction(signal, &previousActions[i], 0);
+            break;
+        }
+    }
+    raise(signal);
+#else
+    Q_UNUSED(signal);
+#endif
+}
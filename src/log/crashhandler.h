@@ -0,0 +1,70 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of CrashHandler, which saves buffered output on fatal signals.
+  */
+
+#ifndef CRASHHANDLER_H
+#define CRASHHANDLER_H
+
+/**
+  Handles the signals a crashing process receives (SIGSEGV, SIGABRT, SIGBUS,
+  SIGFPE and SIGILL) by writing the output still staged in the per-thread
+  buffers to the log file and the console, before handing the signal on to
+  whatever handled it before. Only async-signal-safe calls are made: the
+  staged output is already formatted, and is written with write() to the
+  descriptor of the log file. This is a best effort, as a thread which
+  crashes while appending to its own buffer may leave it inconsistent.
+  The handler runs on an alternate signal stack, so that the output is
+  saved even when the installing thread overflows its stack.
+  Only available on Unix.
+  */
+class CrashHandler
+{
+public:
+    /**
+      Installs the handler for the fatal signals.
+      @returns false if signal handlers are not supported on this platform.
+      */
+    static bool install();
+    /**
+      Restores the handlers which were installed before install().
+      */
+    static void uninstall();
+    /**
+      Is the handler installed?
+      */
+    static bool isInstalled();
+    /**
+      Sets the descriptor staged output is appended to when a signal arrives.
+      @param fd the descriptor of the log file, or -1 if output can not be
+      appended to it directly, as with ring files and mapped files.
+      */
+    static void setLogFile(int fd);
+
+private:
+    /**
+      The signal handler itself.
+      */
+    static void handle(int signal);
+};
+
+#endif // CRASHHANDLER_H
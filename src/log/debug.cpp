@@ -24,44 +24,528 @@
   */
 #include "debug.h"
 
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadStorage>
+#include <QVector>
+#include <QtAlgorithms>
+
+#include <cstdio>
+#include <cstring>
+
+#include "logger.h"
+#include "timestamp.h"
+
+namespace {
+    struct ThreadState;
+    typedef QHash<const char *, Debug::Profiler::Entry> ProfileEntries;
+
+    /// the statistics of threads which have exited.
+    ProfileEntries retiredEntries;
+    /// all live thread states, so report() can merge their statistics.
+    QList<ThreadState *> registry;
+    /// protects the registry and the retired statistics.
+    QMutex registryMutex;
+    /// are scopes profiled rather than logged?
+    QAtomicInt profilerEnabled(0);
+    /// the sampling of call sites which do not set their own.
+    QAtomicInt defaultSampleEvery(0);
+    QAtomicInt defaultSamplePerSecond(0);
+
+    /**
+      The beginning or the end of a traced scope.
+      */
+    struct TraceEvent {
+        /// the identifier of the scope.
+        const char *name;
+        /// when it happened, in nanoseconds since the epoch.
+        qint64 time;
+        /// 'B' for the beginning, 'E' for the end.
+        char phase;
+    };
+
+    /// the number of events a thread buffers before writing them to the trace.
+    const int TRACE_BUFFER_EVENTS = 4096;
+    /// the trace being written, if any.
+    QFile traceFile;
+    /// protects the trace file.
+    QMutex traceMutex;
+    /// are scopes being traced?
+    QAtomicInt tracerActive(0);
+
+    /**
+      Appends text as a JSON string, quotes included.
+      */
+    void appendJsonString(QByteArray &out, const char *text)
+    {
+        out += '"';
+        for(const char *p = text; *p; p++) {
+            unsigned char c = *p;
+            if(c == '"' || c == '\\') {
+                out += '\\';
+                out += char(c);
+            }
+            else if(c < 0x20) {
+                char escaped[8];
+                qsnprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            }
+            else {
+                out += char(c);
+            }
+        }
+        out += '"';
+    }
+
+    /**
+      Writes the events buffered by a thread to the trace, and empties the buffer.
+      The events are formatted before the trace is locked.
+      */
+    void writeEvents(QVector<TraceEvent> &events, quint64 thread)
+    {
+        if(events.isEmpty())
+            return;
+
+        QByteArray json;
+        json.reserve(events.size() * 128);
+        long long pid = QCoreApplication::applicationPid();
+        char fields[128];
+        for(int i = 0; i < events.size(); i++) {
+            const TraceEvent &event = events.at(i);
+            json += "{\"name\":";
+            appendJsonString(json, event.name);
+            // the timestamps are in microseconds
+            qsnprintf(fields, sizeof(fields), ",\"ph\":\"%c\",\"ts\":%lld.%03d,\"pid\":%lld,\"tid\":%llu},\n",
+                      event.phase, (long long)(event.time / 1000), int(event.time % 1000),
+                      pid, (unsigned long long)thread);
+            json += fields;
+        }
+        // keeps the capacity, as it has been reserved
+        events.resize(0);
+
+        QMutexLocker locker(&traceMutex);
+        if(traceFile.isOpen())
+            traceFile.write(json);
+    }
+
+    /**
+      The indentation, the active scopes, the profile and the trace events
+      of a single thread.
+      */
+    struct ThreadState {
+        ThreadState()
+            : numSpaces(0), thread(quint64(quintptr(QThread::currentThreadId())))
+        {
+            scopes.reserve(16);
+            QMutexLocker locker(&registryMutex);
+            registry.append(this);
+        }
+
+        ~ThreadState()
+        {
+            QMutexLocker locker(&registryMutex);
+            registry.removeOne(this);
+            for(ProfileEntries::const_iterator i = entries.constBegin(); i != entries.constEnd(); ++i)
+                retiredEntries[i.key()].merge(i.value());
+            writeEvents(events, thread);
+        }
+
+        /// the number of spaces to indent with.
+        unsigned short numSpaces;
+        /// the identifiers of the active scopes, the innermost last.
+        QVector<const char *> scopes;
+        /// the profile of this thread.
+        ProfileEntries entries;
+        /// the trace events not yet written.
+        QVector<TraceEvent> events;
+        /// the thread this is the state of.
+        quint64 thread;
+        /// protects the profile and the events, only contended while
+        /// another thread runs report() or Tracer::flush().
+        QMutex mutex;
+    };
+
+    /// the state of each thread, so no thread touches another's cache lines.
+    QThreadStorage<ThreadState *> threadStates;
+
+    /**
+      Returns the state of the calling thread, creating it if needed.
+      */
+    ThreadState *threadState()
+    {
+        if(!threadStates.hasLocalData())
+            threadStates.setLocalData(new ThreadState());
+        return threadStates.localData();
+    }
+
+    /**
+      Returns the time on a timer in nanoseconds, as precisely as Qt allows.
+      */
+    qint64 nsecsElapsed(const DebugTimer &timer)
+    {
+#if QT_VERSION >= 0x040800
+        return timer.nsecsElapsed();
+#else
+        return qint64(timer.elapsed()) * 1000000;
+#endif // QT_VERSION 0x040800
+    }
+
+    void record(ThreadState *state, const char *identifier, qint64 nsecs)
+    {
+        QMutexLocker locker(&state->mutex);
+        Debug::Profiler::Entry &entry = state->entries[identifier];
+        entry.identifier = identifier;
+        entry.add(nsecs);
+    }
+
+    void addEvent(ThreadState *state, const char *name, char phase)
+    {
+        TraceEvent event;
+        event.name = name;
+        event.time = Timestamp::now();
+        event.phase = phase;
+
+        QMutexLocker locker(&state->mutex);
+        if(state->events.capacity() < TRACE_BUFFER_EVENTS)
+            state->events.reserve(TRACE_BUFFER_EVENTS);
+        state->events.append(event);
+        if(state->events.size() >= TRACE_BUFFER_EVENTS)
+            writeEvents(state->events, state->thread);
+    }
+
+    bool moreTotalTime(const Debug::Profiler::Entry &a, const Debug::Profiler::Entry &b)
+    {
+        return a.total > b.total;
+    }
+}
+
 namespace Debug {
-    unsigned short Indent::numSpaces = 0;
     Indent::Indent()
     {
     }
 
     void Indent::push()
     {
-        numSpaces += SPACES_PER_LEVEL;
+        threadState()->numSpaces += SPACES_PER_LEVEL;
     }
 
     void Indent::pop()
     {
-        numSpaces -= SPACES_PER_LEVEL;
+        ThreadState *state = threadState();
+        if(state->numSpaces >= SPACES_PER_LEVEL)
+            state->numSpaces -= SPACES_PER_LEVEL;
     }
 
     unsigned short Indent::getIndent()
     {
-        return numSpaces;
+        // threads which never indented have no state, and need none.
+        ThreadState *state = threadStates.localData();
+        return state ? state->numSpaces : 0;
     }
 
     void Indent::reset()
     {
-        numSpaces = 0;
+        threadState()->numSpaces = 0;
+    }
+
+    bool Sampler::admit(int &suppressedCalls)
+    {
+        suppressedCalls = 0;
+        int n = every ? every : int(defaultSampleEvery);
+        int limit = perSecond ? perSecond : int(defaultSamplePerSecond);
+        if(n <= 1 && limit <= 0)
+            return true;
+
+        if(n > 1 && unsigned(calls.fetchAndAddRelaxed(1)) % unsigned(n)) {
+            suppressed.fetchAndAddRelaxed(1);
+            return false;
+        }
+
+        // the first call in a new second starts a new window, and reports
+        // the calls left out before it.
+        int now = int(Timestamp::now() / Q_INT64_C(1000000000));
+        int current = second;
+        if(current != now && second.testAndSetRelaxed(current, now)) {
+            inSecond.fetchAndStoreRelaxed(0);
+            suppressedCalls = suppressed.fetchAndStoreRelaxed(0);
+        }
+
+        if(limit > 0 && inSecond.fetchAndAddRelaxed(1) >= limit) {
+            suppressed.fetchAndAddRelaxed(1);
+            return false;
+        }
+        return true;
+    }
+
+    void Sampler::setDefaults(int every, int perSecond)
+    {
+        defaultSampleEvery = every;
+        defaultSamplePerSecond = perSecond;
+    }
+
+    int Sampler::defaultEvery()
+    {
+        return defaultSampleEvery;
+    }
+
+    int Sampler::defaultPerSecond()
+    {
+        return defaultSamplePerSecond;
     }
 
-    Scope::Scope(const char *str)
-            : identifier(str)
+    Scope::Scope(const char *str, Sampler *sampler)
+            : identifier(str), profiled(Profiler::isEnabled()), traced(Tracer::isActive()), sampled(true)
     {
-        qDebug("Entering %s.", identifier);
+        // decide on sampling before anything is formatted
+        if(!profiled && Logger::isEnabled(DEBUG)) {
+            if(sampler) {
+                int suppressed;
+                sampled = sampler->admit(suppressed);
+                if(suppressed)
+                    qDebug("Suppressed %d calls of %s.", suppressed, identifier);
+            }
+            if(sampled)
+                qDebug("Entering %s.", identifier);
+        }
+        ThreadState *state = threadState();
+        if(sampled)
+            state->numSpaces += Indent::SPACES_PER_LEVEL;
+        state->scopes.append(identifier);
+        if(traced)
+            addEvent(state, identifier, 'B');
         timer.start();
-        Indent::push();
     }
 
     Scope::~Scope()
     {
-        Indent::pop();
-        int ms = timer.elapsed();
-        qDebug("Leaving %s. Took %d ms", identifier, ms);
+        qint64 nsecs = nsecsElapsed(timer);
+        ThreadState *state = threadState();
+        if(traced)
+            addEvent(state, identifier, 'E');
+        if(!state->scopes.isEmpty())
+            state->scopes.remove(state->scopes.size() - 1);
+        if(sampled && state->numSpaces >= Indent::SPACES_PER_LEVEL)
+            state->numSpaces -= Indent::SPACES_PER_LEVEL;
+
+        if(profiled)
+            record(state, identifier, nsecs);
+        else if(sampled && Logger::isEnabled(DEBUG))
+            qDebug("Leaving %s. Took %d ms", identifier, int(nsecs / 1000000));
+    }
+
+    const char *Scope::current()
+    {
+        ThreadState *state = threadStates.localData();
+        return state && !state->scopes.isEmpty() ? state->scopes.last() : 0;
+    }
+
+    QList<const char *> Scope::stack()
+    {
+        QList<const char *> identifiers;
+        ThreadState *state = threadStates.localData();
+        if(state) {
+            for(int i = 0; i < state->scopes.size(); i++)
+                identifiers.append(state->scopes.at(i));
+        }
+        return identifiers;
+    }
+
+    Profiler::Entry::Entry()
+        : identifier(0), count(0), total(0), min(0), max(0)
+    {
+        memset(histogram, 0, sizeof(histogram));
+    }
+
+    void Profiler::Entry::add(qint64 nsecs)
+    {
+        if(nsecs < 0)
+            nsecs = 0;
+        if(!count || nsecs < min)
+            min = nsecs;
+        if(!count || nsecs > max)
+            max = nsecs;
+        ++count;
+        total += nsecs;
+
+        // the bucket is the number of significant bits
+        int bucket = 0;
+        for(qint64 value = nsecs; value && bucket < HISTOGRAM_BUCKETS - 1; value >>= 1)
+            ++bucket;
+        ++histogram[bucket];
+    }
+
+    void Profiler::Entry::merge(const Entry &other)
+    {
+        if(!other.count)
+            return;
+        identifier = other.identifier;
+        if(!count || other.min < min)
+            min = other.min;
+        if(!count || other.max > max)
+            max = other.max;
+        count += other.count;
+        total += other.total;
+        for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+            histogram[i] += other.histogram[i];
+    }
+
+    qint64 Profiler::Entry::mean() const
+    {
+        return count ? total / qint64(count) : 0;
+    }
+
+    qint64 Profiler::Entry::percentile(double fraction) const
+    {
+        quint64 wanted = quint64(fraction * count);
+        if(wanted >= count)
+            wanted = count ? count - 1 : 0;
+        quint64 seen = 0;
+        for(int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+            seen += histogram[i];
+            if(seen > wanted)
+                return i < HISTOGRAM_BUCKETS - 1 ? qMin((Q_INT64_C(1) << i) - 1, max) : max;
+        }
+        return max;
+    }
+
+    void Profiler::setEnabled(bool enabled)
+    {
+        profilerEnabled = enabled ? 1 : 0;
+    }
+
+    bool Profiler::isEnabled()
+    {
+        return profilerEnabled != 0;
+    }
+
+    void Profiler::record(const char *identifier, qint64 nsecs)
+    {
+        ::record(threadState(), identifier, nsecs);
+    }
+
+    QList<Profiler::Entry> Profiler::report()
+    {
+        ProfileEntries merged;
+        {
+            QMutexLocker locker(&registryMutex);
+            merged = retiredEntries;
+            foreach(ThreadState *state, registry) {
+                QMutexLocker stateLocker(&state->mutex);
+                for(ProfileEntries::const_iterator i = state->entries.constBegin();
+                    i != state->entries.constEnd(); ++i)
+                    merged[i.key()].merge(i.value());
+            }
+        }
+
+        QList<Entry> entries = merged.values();
+        qSort(entries.begin(), entries.end(), moreTotalTime);
+        return entries;
+    }
+
+    QString Profiler::formatReport()
+    {
+        QList<Entry> entries = report();
+        if(entries.isEmpty())
+            return QString();
+
+        char line[256];
+        qsnprintf(line, sizeof(line), "%12s %12s %10s %10s %10s %10s  %s",
+                  "calls", "total ms", "mean us", "min us", "p99 us", "max us", "scope");
+        QString text = QString::fromLatin1(line);
+        foreach(const Entry &entry, entries) {
+            qsnprintf(line, sizeof(line), "\n%12llu %12.3f %10.3f %10.3f %10.3f %10.3f  ",
+                      (unsigned long long)entry.count, entry.total / 1e6, entry.mean() / 1e3,
+                      entry.min / 1e3, entry.percentile(0.99) / 1e3, entry.max / 1e3);
+            text += QString::fromLatin1(line);
+            text += QString::fromLatin1(entry.identifier);
+        }
+        return text;
+    }
+
+    void Profiler::reset()
+    {
+        QMutexLocker locker(&registryMutex);
+        retiredEntries.clear();
+        foreach(ThreadState *state, registry) {
+            QMutexLocker stateLocker(&state->mutex);
+            state->entries.clear();
+        }
+    }
+
+    Profiler::Profiler()
+    {
+    }
+
+    bool Tracer::start(const QString &path)
+    {
+        stop();
+
+        QMutexLocker registryLocker(&registryMutex);
+        // forget the events of scopes left since the last trace
+        foreach(ThreadState *state, registry) {
+            QMutexLocker stateLocker(&state->mutex);
+            state->events.resize(0);
+        }
+
+        QMutexLocker locker(&traceMutex);
+        traceFile.setFileName(path);
+        if(!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return false;
+        traceFile.write("[\n");
+        tracerActive = 1;
+        return true;
+    }
+
+    void Tracer::stop()
+    {
+        tracerActive = 0;
+        flush();
+
+        QMutexLocker locker(&traceMutex);
+        if(!traceFile.isOpen())
+            return;
+
+        // name the process in a last event, without a trailing comma,
+        // so the trace is valid JSON.
+        QByteArray json = "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":";
+        json += QByteArray::number(QCoreApplication::applicationPid());
+        json += ",\"args\":{\"name\":";
+        appendJsonString(json, QCoreApplication::applicationName().toUtf8().constData());
+        json += "}}\n]\n";
+        traceFile.write(json);
+        traceFile.close();
+    }
+
+    bool Tracer::isActive()
+    {
+        return tracerActive != 0;
+    }
+
+    void Tracer::begin(const char *name)
+    {
+        addEvent(threadState(), name, 'B');
+    }
+
+    void Tracer::end(const char *name)
+    {
+        addEvent(threadState(), name, 'E');
+    }
+
+    void Tracer::flush()
+    {
+        QMutexLocker locker(&registryMutex);
+        foreach(ThreadState *state, registry) {
+            QMutexLocker stateLocker(&state->mutex);
+            writeEvents(state->events, state->thread);
+        }
+    }
+
+    Tracer::Tracer()
+    {
     }
 }
@@ -39,19 +39,42 @@ typedef QElapsedTimer DebugTimer;
 typedef QTime DebugTimer;
 #endif // QT_VERSION 0x040700
 
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
 #include <QtDebug>
 #include "export.h"
 
 /**
   Handy macro which can be placed at the top of any given function which
   desires to have entry, exit and time taken logged using the LogSingleton.
+  Each use has a Debug::Sampler of its own, so the sampling set with
+  Logger::setLogSampleEvery() and Logger::setLogSampleRate() applies
+  to every function separately.
+  LOG_FUNCTION_SAMPLED(every, perSecond) does the same, but overrides the
+  defaults with sampling of its own: one call in every calls, and at most
+  perSecond calls a second, zero meaning the default for either.
+  Both are left out when QT_NO_DEBUG_OUTPUT is defined, unless LOG_PROFILE_FUNCTIONS
+  is defined too, which keeps them for the Profiler.
   */
-#if defined QT_NO_DEBUG_OUTPUT || defined NO_LOG_FUNCTION
+#if (defined QT_NO_DEBUG_OUTPUT && !defined LOG_PROFILE_FUNCTIONS) || defined NO_LOG_FUNCTION
 #define LOG_FUNCTION
+#define LOG_FUNCTION_SAMPLED(every, perSecond)
 #else
-#define LOG_FUNCTION Debug::Scope __debuggingInstance__(Q_FUNC_INFO);
+#define LOG_FUNCTION LOG_FUNCTION_SAMPLED(0, 0)
+#define LOG_FUNCTION_SAMPLED(every, perSecond) \
+    static Debug::Sampler __debuggingSampler__ = LOG_SAMPLER_INITIALIZER(every, perSecond); \
+    Debug::Scope __debuggingInstance__(Q_FUNC_INFO, &__debuggingSampler__);
 #endif
 
+/**
+  Initialises a Debug::Sampler. Being constant, the initialisation is done
+  before the program starts, so a static Sampler is safe to use from any thread.
+  */
+#define LOG_SAMPLER_INITIALIZER(every, perSecond) \
+    { every, perSecond, Q_BASIC_ATOMIC_INITIALIZER(0), Q_BASIC_ATOMIC_INITIALIZER(0), \
+      Q_BASIC_ATOMIC_INITIALIZER(0), Q_BASIC_ATOMIC_INITIALIZER(0) }
+
 /**
   A namespace for assorted debug classes.
   */
@@ -62,11 +85,12 @@ namespace Debug
       This simply contains the number of spaces the LogSingleton
       should indent with, and has a simple interface to push() and
       pop() indent levels.
+      Every thread has an indent level of its own, so scopes on different
+      threads do not disturb each other.
       */
     class LOGGER_EXPORT Indent {
+        friend class Scope;
     private:
-        /// the number of spaces to indent with
-        static unsigned short numSpaces;
         /// the number of spaces for each level of indentation
         static const unsigned short SPACES_PER_LEVEL = 2;
     public:
@@ -80,13 +104,13 @@ namespace Debug
         static void pop();
 
         /**
-          Returns the number of spaces to indent with.
+          Returns the number of spaces to indent with in the calling thread.
           @return the number of spaces which should be written as indentation.
           */
         static unsigned short getIndent();
 
         /**
-          Resets the number of spaces to indent with.
+          Resets the number of spaces to indent with in the calling thread.
           */
         static void reset();
 
@@ -97,17 +121,75 @@ namespace Debug
         Indent();
     };
 
+    /**
+      Decides which calls of a single call site are logged, for a Scope.
+      A call is logged if it is one in every calls and, of those, one of the
+      first perSecond calls in the current second. The calls left out are
+      counted, and the first call logged in a new second reports them.
+      This is a plain struct, set up with LOG_SAMPLER_INITIALIZER, so that
+      it can be a function-local static created by the LOG_FUNCTION macros.
+      */
+    struct LOGGER_EXPORT Sampler {
+        /**
+          Decides whether to log a call. This is done before anything is
+          formatted, and costs no more than a couple of atomic operations.
+          @param suppressedCalls set to the number of calls left out since
+          the last report, if that is due, and to zero otherwise.
+          @return true if the call shall be logged.
+          */
+        bool admit(int &suppressedCalls);
+
+        /**
+          Sets the sampling of call sites which do not set their own.
+          Zero for either disables that kind of sampling, which is the default.
+          @param every log one call in this many.
+          @param perSecond log at most this many calls a second.
+          @see Logger::setLogSampleEvery(), Logger::setLogSampleRate()
+          */
+        static void setDefaults(int every, int perSecond);
+        /**
+          Returns the default of every.
+          */
+        static int defaultEvery();
+        /**
+          Returns the default of perSecond.
+          */
+        static int defaultPerSecond();
+
+        /// log one call in this many, or 0 for the default.
+        int every;
+        /// log at most this many calls a second, or 0 for the default.
+        int perSecond;
+        /// the number of calls so far.
+        QBasicAtomicInt calls;
+        /// the second, since the epoch, the current window started in.
+        QBasicAtomicInt second;
+        /// the number of calls logged in the current window.
+        QBasicAtomicInt inSecond;
+        /// the number of calls left out since the last report.
+        QBasicAtomicInt suppressed;
+    };
+
     /**
       A simple class responsible for logging its own creation and destruction, as well
       as the time taken between the two. This can be used to give a nice and easy to use
       log sequence of any given function or scope, where an instance can be declared at
       the top of the given function or scope on the stack, and automatically be destructed
       once control reaches the end of that scope.
+      While the Profiler is enabled, nothing is logged. The time taken is
+      recorded by the Profiler instead. While the Tracer is active, the
+      beginning and end of the scope are traced as well.
       */
     class LOGGER_EXPORT Scope {
     private:
         /// a small string identifier meant to give contextual information.
         const char *identifier;
+        /// Is the Profiler recording this scope, rather than the log?
+        bool profiled;
+        /// Is the Tracer recording this scope?
+        bool traced;
+        /// Did the Sampler let this scope through?
+        bool sampled;
 
         /// How long the object has been alive.
         DebugTimer timer;
@@ -117,8 +199,11 @@ namespace Debug
           Sets the identifier to the given string, gets the time when the object was instantiated,
           and logs a simple message of the form "Entering " + str + "." to the LogSingleton with
           a LogLevel of DEBUG.
+          @param str the identifier.
+          @param sampler decides whether this call is logged, if given. Scopes
+          it leaves out are not logged, nor indented, but still profiled and traced.
           */
-        explicit Scope(const char *str);
+        explicit Scope(const char *str, Sampler *sampler = 0);
         /**
           Destructor.
           Calculates the time between creation and destruction of this object, and logs this
@@ -126,6 +211,162 @@ namespace Debug
           LogSingleton with a LogLevel of DEBUG.
           */
         ~Scope();
+
+        /**
+          Returns the identifier of the innermost scope alive in the calling thread.
+          @return the identifier, or 0 if the thread is not inside a Scope.
+          */
+        static const char *current();
+        /**
+          Returns the identifiers of all scopes alive in the calling thread.
+          @return the identifiers, the outermost scope first.
+          */
+        static QList<const char *> stack();
+    };
+
+    /**
+      Collects the time spent in each Scope, rather than logging it.
+      Every thread keeps statistics of its own for each identifier, so
+      recording a Scope only touches memory owned by the calling thread.
+      The statistics of all threads are merged when a report is asked for.
+      Identifiers are told apart by address, as with Q_FUNC_INFO, so they
+      must outlive the Profiler.
+      */
+    class LOGGER_EXPORT Profiler {
+    public:
+        /// the number of buckets in the histogram of each Entry.
+        static const int HISTOGRAM_BUCKETS = 48;
+
+        /**
+          The statistics of a single identifier.
+          */
+        struct LOGGER_EXPORT Entry {
+            /**
+              Constructor.
+              */
+            Entry();
+
+            /**
+              Adds a single duration.
+              */
+            void add(qint64 nsecs);
+            /**
+              Adds the statistics of another entry for the same identifier.
+              */
+            void merge(const Entry &other);
+
+            /**
+              Returns the mean duration, in nanoseconds.
+              */
+            qint64 mean() const;
+            /**
+              Returns an upper bound of the given percentile of the durations,
+              read from the histogram, in nanoseconds.
+              @param fraction the percentile, e.g. 0.99.
+              */
+            qint64 percentile(double fraction) const;
+
+            /// the identifier given to the Scope.
+            const char *identifier;
+            /// the number of times the scope was left.
+            quint64 count;
+            /// the total, shortest and longest durations, in nanoseconds.
+            qint64 total;
+            qint64 min;
+            qint64 max;
+            /// bucket i counts the durations of less than 2^i nanoseconds,
+            /// but at least 2^(i-1). The last bucket also counts anything longer.
+            quint64 histogram[HISTOGRAM_BUCKETS];
+        };
+
+        /**
+          Shall Scope instances be profiled rather than logged?
+          This is disabled by default.
+          @see Logger::setLogProfile()
+          */
+        static void setEnabled(bool enabled);
+        /**
+          Are Scope instances profiled?
+          */
+        static bool isEnabled();
+
+        /**
+          Records a duration for an identifier in the calling thread.
+          Scope does this by itself, but other code may use it too.
+          @param identifier the identifier to record the duration for.
+          @param nsecs the duration, in nanoseconds.
+          */
+        static void record(const char *identifier, qint64 nsecs);
+
+        /**
+          Returns the statistics of all threads merged, the identifiers
+          taking the most time in total first.
+          */
+        static QList<Entry> report();
+        /**
+          Returns report() as a human readable table, or an empty string
+          if nothing has been recorded.
+          */
+        static QString formatReport();
+        /**
+          Forgets everything recorded so far, in all threads.
+          */
+        static void reset();
+
+    private:
+        /**
+          Default constructor.
+          */
+        Profiler();
+    };
+
+    /**
+      Writes the beginning and end of every Scope to a trace in the Chrome
+      trace event format, which chrome://tracing and Perfetto show as a
+      timeline of each thread.
+      Every thread buffers its events, and writes them to the trace a few
+      thousand at a time, so tracing disturbs the timings as little as it
+      can. The events are formatted when they are written, so the names
+      must outlive the Tracer, as with the Profiler.
+      */
+    class LOGGER_EXPORT Tracer {
+    public:
+        /**
+          Starts writing a trace, replacing any trace already being written.
+          @param path the file to write the trace to. It is truncated.
+          @return false if the file could not be opened.
+          @see Logger::setLogTrace()
+          */
+        static bool start(const QString &path);
+        /**
+          Writes out the events of all threads and finishes the trace.
+          */
+        static void stop();
+        /**
+          Is a trace being written?
+          */
+        static bool isActive();
+
+        /**
+          Traces the beginning of a span in the calling thread.
+          Scope does this by itself, but other code may use it too.
+          */
+        static void begin(const char *name);
+        /**
+          Traces the end of the innermost span begun in the calling thread.
+          */
+        static void end(const char *name);
+
+        /**
+          Writes out the events buffered by all threads.
+          */
+        static void flush();
+
+    private:
+        /**
+          Default constructor.
+          */
+        Tracer();
     };
 }
 
@@ -0,0 +1,98 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of FlightRecorder.
+  */
+#include "flightrecorder.h"
+
+#include <QPair>
+#include <QThread>
+#include <QtAlgorithms>
+
+FlightRecorder::FlightRecorder(int capacity)
+    : m_slots(new Slot[qMax(capacity, 1)]), m_capacity(qMax(capacity, 1)), m_next(0)
+{
+}
+
+FlightRecorder::~FlightRecorder()
+{
+    delete[] m_slots;
+}
+
+void FlightRecorder::record(const LogRecord &record)
+{
+    uint sequence = uint(m_next.fetchAndAddRelaxed(1));
+    Slot &slot = m_slots[sequence % uint(m_capacity)];
+
+    // somebody else is in the slot, losing the record beats waiting.
+    if(!slot.busy.testAndSetAcquire(0, 1))
+        return;
+
+    // a thread which claimed the slot a lap later may have got here first,
+    // and its record is the more recent context. The difference is signed,
+    // as the sequence wraps around.
+    if(slot.used && int(slot.sequence - sequence) > 0) {
+        slot.busy.fetchAndStoreRelease(0);
+        return;
+    }
+
+    slot.record = record;
+    slot.sequence = sequence;
+    slot.used = true;
+
+    slot.busy.fetchAndStoreRelease(0);
+}
+
+QList<LogRecord> FlightRecorder::take()
+{
+    uint next = uint(int(m_next));
+    QList<LogRecord> found;
+    // the age of each record found, and where it is, to put them in order.
+    QList<QPair<uint, int> > ages;
+
+    for(int i = 0; i < m_capacity; i++) {
+        Slot &slot = m_slots[i];
+        // a recording thread only holds the slot for the time of a copy.
+        while(!slot.busy.testAndSetAcquire(0, 1))
+            QThread::yieldCurrentThread();
+
+        if(slot.used) {
+            ages.append(qMakePair(next - slot.sequence, found.size()));
+            found.append(slot.record);
+            slot.record = LogRecord();
+            slot.used = false;
+        }
+
+        slot.busy.fetchAndStoreRelease(0);
+    }
+
+    // the oldest record has the greatest age
+    qSort(ages);
+    QList<LogRecord> records;
+    for(int i = ages.size() - 1; i >= 0; i--)
+        records.append(found.at(ages.at(i).second));
+    return records;
+}
+
+int FlightRecorder::capacity() const
+{
+    return m_capacity;
+}
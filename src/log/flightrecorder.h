@@ -0,0 +1,92 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of FlightRecorder, a lock-free ring of the newest records.
+  */
+
+#ifndef FLIGHTRECORDER_H
+#define FLIGHTRECORDER_H
+
+#include <QAtomicInt>
+#include <QList>
+
+#include "logrecord.h"
+
+/**
+  Keeps the newest records below the log threshold in memory, so that
+  the context leading up to a critical message can be written along
+  with it. Recording takes no lock: each record claims the next slot of
+  the ring with an atomic increment, and marks the slot busy while it
+  copies itself in. A record which finds its slot busy, because the
+  ring has wrapped around under another thread or is being taken, is
+  dropped rather than waited for.
+  */
+class FlightRecorder
+{
+public:
+    /**
+      Constructor.
+      @param capacity the number of records kept.
+      */
+    explicit FlightRecorder(int capacity);
+    /**
+      Destructor.
+      */
+    ~FlightRecorder();
+
+    /**
+      Keeps a copy of the record, overwriting the oldest one if the ring is full.
+      */
+    void record(const LogRecord &record);
+    /**
+      Removes the records kept and returns them, oldest first.
+      */
+    QList<LogRecord> take();
+    /**
+      Returns the number of records kept at most.
+      */
+    int capacity() const;
+
+private:
+    /**
+      A slot in the ring.
+      */
+    struct Slot {
+        Slot() : used(false), sequence(0) {}
+        /// set while a thread copies the record in or out.
+        QAtomicInt busy;
+        /// does the slot hold a record?
+        bool used;
+        /// the number the record claimed the slot with, to order the records by.
+        uint sequence;
+        /// the record itself.
+        LogRecord record;
+    };
+
+    /// the ring.
+    Slot *m_slots;
+    /// the number of slots.
+    int m_capacity;
+    /// the sequence number of the next record.
+    QAtomicInt m_next;
+};
+
+#endif // FLIGHTRECORDER_H
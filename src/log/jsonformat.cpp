@@ -0,0 +1,288 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of the JsonFormat namespace.
+  */
+#include "jsonformat.h"
+#include "logcategory.h"
+#include "logrecord.h"
+
+#include <QThreadStorage>
+#include <qnumeric.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+    /// the line buffer of each thread, deleted when the thread exits.
+    QThreadStorage<JsonFormat::Buffer *> localLines;
+
+    const char *const levelNames[] = { "DEBUG", "INFO", "WARNING", "CRITICAL", "NONE" };
+    const char hexDigits[] = "0123456789abcdef";
+
+    inline void appendLiteral(JsonFormat::Buffer &out, const char *text)
+    {
+        out.append(text, int(strlen(text)));
+    }
+
+    /**
+      Appends a character of a string, escaped if JSON requires it.
+      */
+    inline void appendEscaped(JsonFormat::Buffer &out, uchar c)
+    {
+        switch(c) {
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\\':
+            out.append("\\\\", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\t':
+            out.append("\\t", 2);
+            break;
+        default:
+            if(c < 0x20) {
+                char escaped[6] = { '\\', 'u', '0', '0', hexDigits[c >> 4], hexDigits[c & 0xf] };
+                out.append(escaped, 6);
+            }
+            else {
+                out.append(char(c));
+            }
+            break;
+        }
+    }
+
+    /**
+      Appends a code point as UTF-8.
+      */
+    inline void appendUtf8(JsonFormat::Buffer &out, uint code)
+    {
+        char bytes[4];
+        int length;
+        if(code < 0x800) {
+            bytes[0] = char(0xc0 | (code >> 6));
+            bytes[1] = char(0x80 | (code & 0x3f));
+            length = 2;
+        }
+        else if(code < 0x10000) {
+            bytes[0] = char(0xe0 | (code >> 12));
+            bytes[1] = char(0x80 | ((code >> 6) & 0x3f));
+            bytes[2] = char(0x80 | (code & 0x3f));
+            length = 3;
+        }
+        else {
+            bytes[0] = char(0xf0 | (code >> 18));
+            bytes[1] = char(0x80 | ((code >> 12) & 0x3f));
+            bytes[2] = char(0x80 | ((code >> 6) & 0x3f));
+            bytes[3] = char(0x80 | (code & 0x3f));
+            length = 4;
+        }
+        out.append(bytes, length);
+    }
+
+    /**
+      Appends a key and the colon following it.
+      */
+    inline void appendKey(JsonFormat::Buffer &out, const char *key)
+    {
+        JsonFormat::appendString(out, key);
+        out.append(':');
+    }
+
+    /**
+      Appends the members of a line up to the key of the message.
+      */
+    void appendHead(JsonFormat::Buffer &out, LogLevel level, qint64 time, quint64 thread,
+                    unsigned short indent, const LogCategory *category, TimeFormat format, bool utc)
+    {
+        char timestamp[Timestamp::MAX_LENGTH + 1];
+        Timestamp::format(time, format, utc, timestamp);
+
+        out.append('{');
+        appendKey(out, "time");
+        JsonFormat::appendString(out, timestamp);
+        out.append(',');
+        appendKey(out, "level");
+        JsonFormat::appendString(out, levelNames[qBound(0, int(level), int(NONE))]);
+        out.append(',');
+        appendKey(out, "thread");
+        JsonFormat::appendNumber(out, thread);
+        out.append(',');
+        appendKey(out, "indent");
+        JsonFormat::appendNumber(out, quint64(indent));
+        out.append(',');
+        if(category) {
+            appendKey(out, "category");
+            JsonFormat::appendString(out, category->name());
+            out.append(',');
+        }
+        appendKey(out, "msg");
+    }
+
+    /**
+      Appends the fields following the message, and ends the line.
+      */
+    inline void appendTail(JsonFormat::Buffer &out, const char *fields, int size)
+    {
+        if(size) {
+            out.append(',');
+            out.append(fields, size);
+        }
+        out.append("}\n", 2);
+    }
+
+    /**
+      Returns the line buffer of the calling thread, emptied.
+      */
+    JsonFormat::Buffer *localLine()
+    {
+        if(!localLines.hasLocalData())
+            localLines.setLocalData(new JsonFormat::Buffer());
+
+        // resizing to zero keeps the memory of the longest line so far.
+        JsonFormat::Buffer *line = localLines.localData();
+        line->resize(0);
+        return line;
+    }
+}
+
+namespace JsonFormat
+{
+    void appendString(Buffer &out, const char *text)
+    {
+        out.append('"');
+        for(const uchar *c = reinterpret_cast<const uchar *>(text); *c; ++c)
+            appendEscaped(out, *c);
+        out.append('"');
+    }
+
+    void appendString(Buffer &out, const QString &text)
+    {
+        out.append('"');
+        const ushort *c = text.utf16();
+        const ushort *end = c + text.size();
+        for(; c != end; ++c) {
+            uint code = *c;
+            if(code < 0x80) {
+                appendEscaped(out, uchar(code));
+                continue;
+            }
+            // combine surrogate pairs, and replace lone surrogates.
+            if(code >= 0xd800 && code < 0xdc00 && c + 1 != end && c[1] >= 0xdc00 && c[1] < 0xe000) {
+                code = 0x10000 + ((code - 0xd800) << 10) + (c[1] - 0xdc00);
+                ++c;
+            }
+            else if(code >= 0xd800 && code < 0xe000) {
+                code = 0xfffd;
+            }
+            appendUtf8(out, code);
+        }
+        out.append('"');
+    }
+
+    void appendNumber(Buffer &out, qint64 value)
+    {
+        if(value >= 0) {
+            appendNumber(out, quint64(value));
+            return;
+        }
+        out.append('-');
+        // negate without overflowing for the lowest value
+        appendNumber(out, quint64(-(value + 1)) + 1);
+    }
+
+    void appendNumber(Buffer &out, quint64 value)
+    {
+        char digits[20];
+        char *first = digits + sizeof(digits);
+        do {
+            *--first = char('0' + value % 10);
+            value /= 10;
+        } while(value);
+        out.append(first, int(digits + sizeof(digits) - first));
+    }
+
+    void appendNumber(Buffer &out, double value)
+    {
+        if(!qIsFinite(value)) {
+            appendLiteral(out, "null");
+            return;
+        }
+
+        // the shortest precision which reads back as the same value
+        char digits[32];
+        int length = qsnprintf(digits, sizeof(digits), "%.15g", value);
+        if(strtod(digits, 0) != value)
+            length = qsnprintf(digits, sizeof(digits), "%.17g", value);
+
+        // the application may have set a locale with a decimal comma.
+        for(int i = 0; i < length; ++i) {
+            if(digits[i] == ',')
+                digits[i] = '.';
+        }
+        out.append(digits, length);
+    }
+
+    void appendBool(Buffer &out, bool value)
+    {
+        appendLiteral(out, value ? "true" : "false");
+    }
+
+    void appendRecord(Buffer &out, const LogRecord &record, TimeFormat format, bool utc)
+    {
+        appendHead(out, record.level, record.time, record.thread, record.indent, record.category,
+                   format, utc);
+        appendString(out, record.message);
+        appendTail(out, record.fields.constData(), record.fields.size());
+    }
+
+    QByteArray renderRecord(const LogRecord &record, TimeFormat format, bool utc)
+    {
+        Buffer *line = localLine();
+        appendRecord(*line, record, format, utc);
+        return QByteArray::fromRawData(line->constData(), line->size());
+    }
+
+    QByteArray renderMessage(LogLevel level, qint64 time, quint64 thread, unsigned short indent,
+                             const char *message, const char *fields, int fieldsSize,
+                             TimeFormat format, bool utc)
+    {
+        Buffer *line = localLine();
+        appendHead(*line, level, time, thread, indent, 0, format, utc);
+        appendString(*line, message);
+        appendTail(*line, fields, fieldsSize);
+        return QByteArray::fromRawData(line->constData(), line->size());
+    }
+
+    QByteArray encodeRecord(const LogRecord &record, TimeFormat format, bool utc)
+    {
+        Buffer line;
+        appendRecord(line, record, format, utc);
+        return QByteArray(line.constData(), line.size());
+    }
+}
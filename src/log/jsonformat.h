@@ -0,0 +1,128 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of the JsonFormat namespace, writing log messages as JSON Lines.
+
+  In the JSON format every message is a single line holding one JSON object:
+  {"time":"21:04:01.042","level":"INFO","thread":140213,"indent":0,"msg":"Started"}
+  followed by the fields of the message, if it was logged with LogFields,
+  and by "category" if it was logged in a LogCategory. The time is printed
+  in the configured TimeFormat. Strings are written as UTF-8.
+  */
+
+#ifndef JSONFORMAT_H
+#define JSONFORMAT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVarLengthArray>
+#include <QtGlobal>
+
+#include "export.h"
+// for TimeFormat
+#include "logger.h"
+
+struct LogRecord;
+
+/**
+  A namespace for writing the JSON format.
+  Values are escaped and converted straight into a byte buffer, without
+  going through QString, QVariant or a JSON document.
+  */
+namespace JsonFormat
+{
+    /// the buffer lines and fields are built in. Most fit in the inline part.
+    typedef QVarLengthArray<char, 512> Buffer;
+
+    /**
+      Appends a string value, quoted and escaped.
+      @param out the buffer to append to.
+      @param text the string, as NUL terminated UTF-8.
+      */
+    LOGGER_EXPORT void appendString(Buffer &out, const char *text);
+    /**
+      Appends a string value, quoted, escaped and converted to UTF-8.
+      @param out the buffer to append to.
+      @param text the string.
+      */
+    LOGGER_EXPORT void appendString(Buffer &out, const QString &text);
+    /**
+      Appends an integer value.
+      */
+    LOGGER_EXPORT void appendNumber(Buffer &out, qint64 value);
+    /**
+      Appends an unsigned integer value.
+      */
+    LOGGER_EXPORT void appendNumber(Buffer &out, quint64 value);
+    /**
+      Appends a floating point value with as few digits as read back the same.
+      JSON has no infinities nor NaN, so those are written as null.
+      */
+    LOGGER_EXPORT void appendNumber(Buffer &out, double value);
+    /**
+      Appends true or false.
+      */
+    LOGGER_EXPORT void appendBool(Buffer &out, bool value);
+
+    /**
+      Appends a record as a single line of JSON, including the newline.
+      @param out the buffer to append to.
+      @param record the message.
+      @param format how to print the time of the message.
+      @param utc true to print the time in UTC, false for local time.
+      */
+    LOGGER_EXPORT void appendRecord(Buffer &out, const LogRecord &record, TimeFormat format, bool utc);
+
+    /**
+      Renders a record into a buffer owned by the calling thread, which is
+      reused for every record so that no memory is allocated once it has
+      grown to fit the longest line.
+      @returns the line, referring to the buffer of the thread. It is only
+      valid until the thread renders the next record, and must be copied to
+      be kept.
+      */
+    LOGGER_EXPORT QByteArray renderRecord(const LogRecord &record, TimeFormat format, bool utc);
+
+    /**
+      Renders a message into the buffer of the calling thread like
+      renderRecord(), straight from the text and fields it was logged with.
+      @param level the priority of the message.
+      @param time when the message was logged, in nanoseconds since the epoch.
+      @param thread the thread the message was logged from.
+      @param indent the indentation of the message.
+      @param message the message, as NUL terminated UTF-8.
+      @param fields the fields as JSON object members, see LogFields::data().
+      @param fieldsSize the length of the fields.
+      @param format how to print the time of the message.
+      @param utc true to print the time in UTC, false for local time.
+      @returns the line, valid until the thread renders the next one.
+      */
+    LOGGER_EXPORT QByteArray renderMessage(LogLevel level, qint64 time, quint64 thread, unsigned short indent,
+                                           const char *message, const char *fields, int fieldsSize,
+                                           TimeFormat format, bool utc);
+
+    /**
+      Encodes a record as a line of JSON in a QByteArray of its own.
+      */
+    LOGGER_EXPORT QByteArray encodeRecord(const LogRecord &record, TimeFormat format, bool utc);
+}
+
+#endif // JSONFORMAT_H
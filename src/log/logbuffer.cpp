@@ -0,0 +1,168 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of LogBuffer.
+  */
+#include "logbuffer.h"
+#include "logger.h"
+
+#include <QList>
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+#if defined(Q_OS_UNIX)
+#   include <cerrno>
+#   include <unistd.h>
+#endif
+
+namespace {
+    /// the buffer of each thread, deleted when the thread exits.
+    QThreadStorage<LogBuffer *> localBuffer;
+    /// all live buffers, so that close() can flush them.
+    QList<LogBuffer *> registry;
+    /// protects the registry.
+    QMutex registryMutex;
+
+    /**
+      Writes all of the data to the descriptor, using nothing but write().
+      */
+    void writeFully(int fd, const char *data, int size)
+    {
+#if defined(Q_OS_UNIX)
+        while(size > 0) {
+            ssize_t written = ::write(fd, data, size);
+            // a signal arriving during the write is no reason to give up
+            if(written < 0 && errno == EINTR)
+                continue;
+            if(written <= 0)
+                return;
+            data += written;
+            size -= written;
+        }
+#else
+        Q_UNUSED(fd);
+        Q_UNUSED(data);
+        Q_UNUSED(size);
+#endif
+    }
+}
+
+LogBuffer::LogBuffer()
+    : m_lines(0), m_format(TEXT_FORMAT)
+{
+    QMutexLocker locker(&registryMutex);
+    registry.append(this);
+}
+
+LogBuffer::~LogBuffer()
+{
+    // announce the flush before looking up the instance, as the message
+    // handler does, so close() can not delete it under our feet. Should
+    // close() have got there first, we are still registered, so the
+    // Logger flushes us before it goes.
+    Logger::m_handlerCalls.ref();
+    {
+        QMutexLocker locker(&m_mutex);
+        flush(Logger::_instance);
+    }
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.removeOne(this);
+    }
+    Logger::m_handlerCalls.deref();
+}
+
+void LogBuffer::append(Logger *logger, const QByteArray &file, const QByteArray &console,
+                       LogFormat format, int maxSize, int interval)
+{
+    if(!localBuffer.hasLocalData())
+        localBuffer.setLocalData(new LogBuffer());
+
+    LogBuffer *buffer = localBuffer.localData();
+    // only contended while another thread runs flushAll() or flushExpired().
+    QMutexLocker locker(&buffer->m_mutex);
+
+    // a batch is written in a single format
+    if(buffer->m_lines && format != buffer->m_format)
+        buffer->flush(logger);
+    buffer->m_format = format;
+
+    if(!buffer->m_lines) {
+        buffer->m_age.start();
+        if(buffer->m_file.capacity() < maxSize)
+            buffer->m_file.reserve(maxSize);
+    }
+
+    buffer->m_file.append(file);
+    buffer->m_console.append(console);
+    ++buffer->m_lines;
+
+    if(buffer->m_file.size() >= maxSize || buffer->m_age.elapsed() >= interval)
+        buffer->flush(logger);
+}
+
+void LogBuffer::flushAll(Logger *logger)
+{
+    QMutexLocker locker(&registryMutex);
+
+    foreach(LogBuffer *buffer, registry) {
+        QMutexLocker bufferLocker(&buffer->m_mutex);
+        buffer->flush(logger);
+    }
+}
+
+void LogBuffer::flushExpired(Logger *logger, int interval)
+{
+    QMutexLocker locker(&registryMutex);
+
+    foreach(LogBuffer *buffer, registry) {
+        QMutexLocker bufferLocker(&buffer->m_mutex);
+        if(buffer->m_lines && buffer->m_age.elapsed() >= interval)
+            buffer->flush(logger);
+    }
+}
+
+void LogBuffer::writeUnsafe(int file, int console)
+{
+    // the registry is only read, a crashing process can not wait for locks.
+    for(int i = 0; i < registry.size(); i++) {
+        const LogBuffer *buffer = registry.at(i);
+        if(file >= 0)
+            writeFully(file, buffer->m_file.constData(), buffer->m_file.size());
+        if(console >= 0)
+            writeFully(console, buffer->m_console.constData(), buffer->m_console.size());
+    }
+}
+
+void LogBuffer::flush(Logger *logger)
+{
+    if(!m_lines)
+        return;
+
+    if(logger)
+        logger->writeStaged(m_file, m_console, m_lines, m_format);
+
+    // the reserved capacity is kept around for the next batch.
+    m_file.resize(0);
+    m_console.resize(0);
+    m_lines = 0;
+}
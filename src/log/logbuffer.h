@@ -0,0 +1,123 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of LogBuffer, the per-thread staging buffer used when buffering output.
+  */
+
+#ifndef LOGBUFFER_H
+#define LOGBUFFER_H
+
+#include <QByteArray>
+#include <QMutex>
+
+// for DebugTimer
+#include "debug.h"
+// for LogFormat
+#include "logger.h"
+
+/**
+  A staging buffer holding formatted log output for a single thread.
+  Each thread appends its formatted lines to its own buffer, and only
+  hands the buffer over to the Logger when it has grown beyond a given
+  size or has held data for longer than a given interval. This means
+  the operational mutex is taken once per flush rather than once per
+  message, and that lines from one thread are written in order.
+  The buffers of all threads are kept in a registry so that they can
+  all be flushed when the Logger is closed, and so that LogFlusher can
+  write out those left idle.
+  */
+class LogBuffer
+{
+public:
+    /**
+      Appends a formatted line to the calling thread's buffer, and flushes
+      the buffer if it has reached the size or time threshold.
+      @param logger the Logger to flush through.
+      @param file the line as it should be written to the log file.
+      @param console the line as it should be written to the console,
+      or an empty array if it should not be written to the console.
+      @param format the format the line was rendered in for the log file.
+      @param maxSize flush when the buffer holds this many bytes.
+      @param interval flush when the buffer has held data for this many ms.
+      */
+    static void append(Logger *logger, const QByteArray &file, const QByteArray &console,
+                       LogFormat format, int maxSize, int interval);
+
+    /**
+      Flushes the buffers of all threads.
+      @param logger the Logger to flush through.
+      */
+    static void flushAll(Logger *logger);
+
+    /**
+      Flushes the buffers which have held data for at least the given
+      interval, so that the output of threads which have stopped logging
+      does not wait for their next message. Called by LogFlusher.
+      @param logger the Logger to flush through.
+      @param interval flush the buffers which have held data for this many ms.
+      */
+    static void flushExpired(Logger *logger, int interval);
+
+    /**
+      Writes the buffers of all threads straight to the given descriptors,
+      without taking any locks or allocating memory. Only meant for a
+      signal handler in a crashing process, see CrashHandler.
+      @param file the descriptor of the log file, or -1 to skip it.
+      @param console the descriptor of the console, or -1 to skip it.
+      */
+    static void writeUnsafe(int file, int console);
+
+    /**
+      Destructor.
+      Called when the owning thread exits. Flushes any remaining
+      output and removes the buffer from the registry.
+      */
+    ~LogBuffer();
+
+private:
+    /**
+      Default constructor.
+      Adds the buffer to the registry.
+      */
+    LogBuffer();
+
+    /**
+      Hands the buffered output over to the logger.
+      m_mutex must be held when calling this.
+      */
+    void flush(Logger *logger);
+
+    /// protects the buffer against flushAll() and flushExpired() from other threads.
+    QMutex m_mutex;
+    /// output waiting to be written to the log file.
+    QByteArray m_file;
+    /// output waiting to be written to the console.
+    QByteArray m_console;
+    /// the number of lines waiting to be written.
+    int m_lines;
+    /// the format the lines were rendered in for the log file.
+    LogFormat m_format;
+    /// how long the oldest line has been waiting.
+    DebugTimer m_age;
+};
+
+#endif // LOGBUFFER_H
@@ -0,0 +1,139 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogCategory.
+  */
+#include "logcategory.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace {
+    /**
+      The categories and the thresholds set for them by name.
+      */
+    struct Registry {
+        Registry()
+            : logThreshold(DEBUG), otherThreshold(NONE)
+        {
+        }
+
+        /// protects the registry.
+        QMutex mutex;
+        /// every category, by name.
+        QMultiHash<QString, LogCategory *> categories;
+        /// the thresholds set by name, including names not registered yet.
+        QHash<QString, int> thresholds;
+        /// the log threshold, followed by categories without one of their own.
+        /// Everything is let through until a Logger says otherwise.
+        int logThreshold;
+        /// the lowest threshold of anything else that wants messages.
+        int otherThreshold;
+    };
+
+    /**
+      Returns the registry, which is created by the first category
+      registered, whichever source file it is in.
+      */
+    Registry &registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+}
+
+LogCategory::LogCategory(const char *name)
+    : m_name(name), m_threshold(DEBUG), m_enabled(DEBUG)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.categories.insert(QString::fromLatin1(name), this);
+    update(r.thresholds.value(QString::fromLatin1(name), -1));
+}
+
+LogCategory::~LogCategory()
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.categories.remove(QString::fromLatin1(m_name), this);
+}
+
+LogLevel LogCategory::threshold() const
+{
+    return (LogLevel)(int)m_threshold;
+}
+
+void LogCategory::setThreshold(const QString &name, LogLevel level)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.thresholds.insert(name, level);
+    foreach(LogCategory *category, r.categories.values(name))
+        category->update(level);
+}
+
+void LogCategory::clearThreshold(const QString &name)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.thresholds.remove(name);
+    foreach(LogCategory *category, r.categories.values(name))
+        category->update(-1);
+}
+
+bool LogCategory::threshold(const QString &name, LogLevel &threshold)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    QHash<QString, int>::const_iterator it = r.thresholds.constFind(name);
+    if(it == r.thresholds.constEnd())
+        return false;
+    threshold = (LogLevel)it.value();
+    return true;
+}
+
+QStringList LogCategory::names()
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.categories.uniqueKeys();
+}
+
+void LogCategory::setDefaults(int logThreshold, int otherThreshold)
+{
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    r.logThreshold = logThreshold;
+    r.otherThreshold = otherThreshold;
+
+    QMultiHash<QString, LogCategory *>::const_iterator it;
+    for(it = r.categories.constBegin(); it != r.categories.constEnd(); ++it)
+        it.value()->update(r.thresholds.value(it.key(), -1));
+}
+
+void LogCategory::update(int explicitThreshold)
+{
+    const Registry &r = registry();
+    int threshold = explicitThreshold >= 0 ? explicitThreshold : r.logThreshold;
+    m_threshold = threshold;
+    m_enabled = qMin(threshold, r.otherThreshold);
+}
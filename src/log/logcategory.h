@@ -0,0 +1,173 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogCategory, a named subsystem with a log threshold of its own.
+  */
+
+#ifndef LOGCATEGORY_H
+#define LOGCATEGORY_H
+
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+
+#include "logger.h"
+
+/**
+  A named part of the application, e.g. "net", "db" or "plugin.xml", whose
+  messages are filtered by a threshold of its own rather than by the log
+  threshold. A category without a threshold of its own follows the log
+  threshold. Thresholds are set by name, with Logger::setCategoryThreshold()
+  or the Log/log_category/<name> settings, and apply to every LogCategory
+  of that name.
+  A category is meant to be declared once per source file with LOG_CATEGORY,
+  so the name is only looked up when the file is loaded. Whether a level
+  is enabled is kept in the category itself, so a disabled message costs
+  a single load and a branch.
+  */
+class LOGGER_EXPORT LogCategory
+{
+public:
+    /**
+      Constructor.
+      Registers the category, so it follows the threshold set for its name.
+      @param name the name of the category.
+      */
+    explicit LogCategory(const char *name);
+    /**
+      Destructor.
+      */
+    ~LogCategory();
+
+    /**
+      Returns the name of the category.
+      */
+    const char *name() const { return m_name; }
+
+    /**
+      Will a message of the given level in this category be logged?
+      This is a single relaxed load, like Logger::isEnabled().
+      @param level the priority of the message.
+      */
+    bool isEnabled(LogLevel level) const
+    {
+        return level >= m_enabled;
+    }
+
+    /**
+      Returns the threshold messages of this category are written to the
+      log file and the console with.
+      */
+    LogLevel threshold() const;
+
+    /**
+      Sets the threshold of every category with the given name.
+      @param name the name of the categories.
+      @param level the threshold to use.
+      */
+    static void setThreshold(const QString &name, LogLevel level);
+    /**
+      Lets the categories with the given name follow the log threshold again.
+      @param name the name of the categories.
+      */
+    static void clearThreshold(const QString &name);
+    /**
+      Returns the threshold set for the given name.
+      @param name the name of the categories.
+      @param threshold set to the threshold, if there is one.
+      @returns false if the categories follow the log threshold.
+      */
+    static bool threshold(const QString &name, LogLevel &threshold);
+    /**
+      Returns the names of all categories registered so far.
+      */
+    static QStringList names();
+    /**
+      Sets the thresholds categories without a threshold of their own follow.
+      @param logThreshold the log threshold.
+      @param otherThreshold the lowest threshold of anything else which
+      wants messages, such as the sinks.
+      */
+    static void setDefaults(int logThreshold, int otherThreshold);
+
+private:
+    /**
+      Works out the thresholds from the threshold set for the name, if any,
+      and the defaults. The registry mutex must be held when calling this.
+      */
+    void update(int explicitThreshold);
+
+    /// the name of the category.
+    const char *m_name;
+    /// the threshold for the log file and the console.
+    QAtomicInt m_threshold;
+    /// the lowest level anything wants, checked by isEnabled().
+    QAtomicInt m_enabled;
+};
+
+/**
+  Declares a category for the rest of the source file, e.g.
+  LOG_CATEGORY(net, "net"). The category is registered when the
+  file is loaded, rather than looked up whenever a message is logged.
+  */
+#define LOG_CATEGORY(variable, name) static LogCategory variable(name)
+
+/**
+  Logs a printf-style message in the given category at the given level,
+  provided the level is enabled for the category. Like LOG_AT, this costs
+  a single load and a branch for disabled levels.
+  */
+#define LOG_CATEGORY_AT(category, level, ...) \
+    do { \
+        if((category).isEnabled(level)) \
+            Logger::logAt(category, level, __VA_ARGS__); \
+    } while(0)
+
+/**
+  Handy macros for logging printf-style messages in a category, e.g.
+  LOG_CDEBUG(net, "Connected to %s", host).
+  @see LOG_CATEGORY_AT
+  */
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_CDEBUG(category, ...) LOG_CATEGORY_AT(category, DEBUG, __VA_ARGS__)
+#else
+#define LOG_CDEBUG(category, ...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_CINFO(category, ...) LOG_CATEGORY_AT(category, INFO, __VA_ARGS__)
+#else
+#define LOG_CINFO(category, ...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_CWARNING(category, ...) LOG_CATEGORY_AT(category, WARNING, __VA_ARGS__)
+#else
+#define LOG_CWARNING(category, ...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_CRITICAL
+#define LOG_CCRITICAL(category, ...) LOG_CATEGORY_AT(category, CRITICAL, __VA_ARGS__)
+#else
+#define LOG_CCRITICAL(category, ...) do { } while(0)
+#endif
+
+#endif // LOGCATEGORY_H
@@ -0,0 +1,127 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogCollapser.
+  */
+#include "logcollapser.h"
+#include "logrecord.h"
+
+#include <QHash>
+#include <QList>
+#include <QMutexLocker>
+#include <QThreadStorage>
+
+namespace {
+    /// the collapser of each thread, deleted when the thread exits.
+    QThreadStorage<LogCollapser *> localCollapser;
+    /// all live collapsers, so that flush() and close() can report them.
+    QList<LogCollapser *> registry;
+    /// protects the registry.
+    QMutex registryMutex;
+}
+
+LogCollapser::LogCollapser()
+    : m_valid(false), m_level(DEBUG), m_hash(0), m_format(0), m_repeats(0),
+      m_thread(LogRecord::currentThread())
+{
+    QMutexLocker locker(&registryMutex);
+    registry.append(this);
+}
+
+LogCollapser::~LogCollapser()
+{
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.removeOne(this);
+    }
+
+    // announce the report before looking up the instance, as the message
+    // handler does, so close() can not delete it under our feet.
+    Logger::m_handlerCalls.ref();
+    {
+        QMutexLocker locker(&m_mutex);
+        report(Logger::_instance);
+    }
+    Logger::m_handlerCalls.deref();
+}
+
+bool LogCollapser::collapse(Logger *logger, LogLevel level, const QString &message,
+                            const char *format, const QByteArray &arguments, int interval)
+{
+    if(!localCollapser.hasLocalData())
+        localCollapser.setLocalData(new LogCollapser());
+
+    LogCollapser *collapser = localCollapser.localData();
+    // only contended while another thread runs flushAll() or reportExpired().
+    QMutexLocker locker(&collapser->m_mutex);
+
+    uint hash = qHash(arguments) ^ (format ? qHash(format) : qHash(message));
+
+    // the text is only compared when the hashes match.
+    if(collapser->m_valid && hash == collapser->m_hash && level == collapser->m_level
+       && format == collapser->m_format && arguments == collapser->m_arguments
+       && (format || message == collapser->m_message)) {
+        ++collapser->m_repeats;
+        if(collapser->m_age.elapsed() >= interval)
+            collapser->report(logger);
+        return true;
+    }
+
+    collapser->report(logger);
+
+    collapser->m_valid = true;
+    collapser->m_level = level;
+    collapser->m_hash = hash;
+    collapser->m_message = message;
+    collapser->m_format = format;
+    collapser->m_arguments = arguments;
+    return false;
+}
+
+void LogCollapser::flushAll(Logger *logger)
+{
+    QMutexLocker locker(&registryMutex);
+
+    foreach(LogCollapser *collapser, registry) {
+        QMutexLocker collapserLocker(&collapser->m_mutex);
+        collapser->report(logger);
+    }
+}
+
+void LogCollapser::reportExpired(Logger *logger, int interval)
+{
+    QMutexLocker locker(&registryMutex);
+
+    foreach(LogCollapser *collapser, registry) {
+        QMutexLocker collapserLocker(&collapser->m_mutex);
+        if(collapser->m_repeats && collapser->m_age.elapsed() >= interval)
+            collapser->report(logger);
+    }
+}
+
+void LogCollapser::report(Logger *logger)
+{
+    if(m_repeats && logger)
+        logger->logRepeats(m_level, m_repeats, m_thread);
+
+    m_repeats = 0;
+    m_age.start();
+}
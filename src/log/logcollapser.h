@@ -0,0 +1,126 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogCollapser, which holds back repeated messages of a thread.
+  */
+
+#ifndef LOGCOLLAPSER_H
+#define LOGCOLLAPSER_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+
+// for DebugTimer
+#include "debug.h"
+// for LogLevel
+#include "logger.h"
+
+/**
+  Remembers the last message logged by a single thread, so that repeats
+  of it can be counted rather than written. Once a different message
+  arrives, or the repeats have been held back for longer than a given
+  interval, a single "Last message repeated N times." line is written
+  in their place. During a storm of identical messages this turns
+  thousands of writes into one per interval.
+  Messages are compared by hash first, so that different messages
+  are told apart without comparing their text.
+  The collapsers of all threads are kept in a registry so that the
+  pending repeats can be reported when the Logger is flushed or closed.
+  */
+class LogCollapser
+{
+public:
+    /**
+      Checks whether a message repeats the previous message of the calling
+      thread. A repeat is counted and shall not be logged. Otherwise the
+      repeats of the previous message, if any, are reported before the
+      message is remembered.
+      @param logger the Logger to report repeats through.
+      @param level the level of the message.
+      @param message the text of the message, if it has been formatted.
+      @param format the format string of the message, if it has not.
+      @param arguments the encoded arguments of the message if it has not
+      been formatted, or its structured fields if it has.
+      @param interval report held back repeats at least this often, in ms.
+      @returns true if the message is a repeat and shall not be logged.
+      */
+    static bool collapse(Logger *logger, LogLevel level, const QString &message,
+                         const char *format, const QByteArray &arguments, int interval);
+
+    /**
+      Reports the pending repeats of all threads.
+      @param logger the Logger to report through.
+      */
+    static void flushAll(Logger *logger);
+
+    /**
+      Reports the repeats which have been held back for at least the given
+      interval, so that a storm which has ended is reported without waiting
+      for the thread's next message. Called by LogFlusher.
+      @param logger the Logger to report through.
+      @param interval report the repeats held back for this many ms.
+      */
+    static void reportExpired(Logger *logger, int interval);
+
+    /**
+      Destructor.
+      Called when the owning thread exits. Reports any pending repeats
+      and removes the collapser from the registry.
+      */
+    ~LogCollapser();
+
+private:
+    /**
+      Default constructor.
+      Adds the collapser to the registry.
+      */
+    LogCollapser();
+
+    /**
+      Reports the repeats counted so far, if any, and starts counting anew.
+      m_mutex must be held when calling this.
+      */
+    void report(Logger *logger);
+
+    /// protects the state against flushAll() and reportExpired() from other threads.
+    QMutex m_mutex;
+    /// Has a message been remembered yet?
+    bool m_valid;
+    /// the level of the last message.
+    LogLevel m_level;
+    /// the hash of the last message.
+    uint m_hash;
+    /// the text of the last message, if it was formatted.
+    QString m_message;
+    /// the format string of the last message, if it was not.
+    const char *m_format;
+    /// the encoded arguments of the last message, if it was not formatted.
+    QByteArray m_arguments;
+    /// how many times the last message has been repeated since it was reported.
+    int m_repeats;
+    /// how long the repeats have been held back.
+    DebugTimer m_age;
+    /// the thread owning the collapser, which the repeats are reported for.
+    quint64 m_thread;
+};
+
+#endif // LOGCOLLAPSER_H
@@ -0,0 +1,88 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogConfig, a snapshot of the settings of the Logger.
+  */
+
+#ifndef LOGCONFIG_H
+#define LOGCONFIG_H
+
+#include <QtGlobal>
+
+// for TimeFormat, OverflowPolicy and LogFormat
+#include "logger.h"
+
+/**
+  The settings of the Logger which are read while logging, without holding
+  the operational mutex. A LogConfig is never changed once it has been
+  published: a setter, or a reload of the settings, copies the current one,
+  changes the copy and publishes it through an atomic pointer in its place.
+  Logging threads load the pointer once and see either the old snapshot or
+  the new one, never a mix of the two, and never wait for a writer.
+  A logging thread may hold on to a snapshot for as long as it waits for
+  the operational mutex or the writer, which is not bounded, so replaced
+  snapshots are only deleted when the Logger is closed.
+  */
+struct LogConfig
+{
+    /**
+      Default constructor.
+      */
+    LogConfig()
+        : logToConsole(true), logLimit(0), logMaxSize(0), logGenerations(0),
+          timeFormat(TIME_OF_DAY), timeUtc(false),
+          bufferSize(0), flushInterval(0), repeatInterval(0), overflowPolicy(OVERFLOW_BLOCK),
+          statsInterval(0), logFormat(TEXT_FORMAT), logRingSize(0), logMapped(false)
+    {
+    }
+
+    /// Shall we log to the console as well as the file?
+    bool logToConsole;
+    /// How many lines should be logged before we truncate the file?
+    int logLimit;
+    /// At which size do we rotate the logfile? Zero disables rotation.
+    qint64 logMaxSize;
+    /// How many rotated generations do we keep?
+    int logGenerations;
+    /// how the time of a message is printed.
+    TimeFormat timeFormat;
+    /// Are times printed in UTC rather than local time?
+    bool timeUtc;
+    /// How many bytes may a per-thread buffer hold? Zero disables buffering.
+    int bufferSize;
+    /// How many ms may a per-thread buffer hold data?
+    int flushInterval;
+    /// How many ms may repeated messages be held back? Zero disables collapsing.
+    int repeatInterval;
+    /// What happens to a message when the asynchronous queue is full?
+    OverflowPolicy overflowPolicy;
+    /// How many ms between lines of statistics? Zero disables them.
+    int statsInterval;
+    /// the format of the log file. Records are encoded for it while logging,
+    /// and the file reopened by the setter.
+    LogFormat logFormat;
+    /// How large is the ring, if the logfile is one? Zero if it is not.
+    qint64 logRingSize;
+    /// Shall the logfile be written through a memory mapping?
+    bool logMapped;
+};
+
+#endif // LOGCONFIG_H
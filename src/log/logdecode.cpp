@@ -0,0 +1,664 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  logdecode - decodes and filters log files written by Logger.
+
+  Binary logs are decoded back into the text format written by Logger,
+  ring files are put back in chronological order, and text and JSON Lines
+  logs are passed through. Any of them can be filtered by level and
+  time, and binary logs also by thread. The input is memory mapped
+  and processed as a stream, so the size of the log does not matter.
+  */
+#include "binaryformat.h"
+#include "logger.h"
+#include "ringfile.h"
+#include "timestamp.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <QByteArray>
+#include <QDate>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QString>
+#include <QTime>
+
+namespace {
+    /// the level tags, padded the way Logger pads them.
+    const char *levelTags[] = { "[DEBUG]    ", "[INFO]     ", "[WARNING]  ", "[CRITICAL] " };
+    /// the level names, as used in the settings.
+    const char *levelNames[] = { "DEBUG", "INFO", "WARNING", "CRITICAL", "NONE" };
+    /// how a line of the JSON format starts, and the level member following the time.
+    const char JSON_TIME[] = "{\"time\":\"";
+    const int JSON_TIME_LENGTH = sizeof(JSON_TIME) - 1;
+    const char JSON_LEVEL[] = ",\"level\":\"";
+    const int JSON_LEVEL_LENGTH = sizeof(JSON_LEVEL) - 1;
+    const int MSECS_PER_DAY = 24 * 60 * 60 * 1000;
+    const qint64 NSECS_PER_MSEC = 1000000;
+    const qint64 NSECS_PER_SEC = 1000000000;
+
+    const qint64 MAX_MSECS = Q_INT64_C(0x7fffffffffffffff);
+
+    /**
+      What to let through.
+      */
+    struct Filter {
+        Filter()
+            : minLevel(DEBUG), from(0), to(MSECS_PER_DAY), dated(false), fromDate(0), toDate(MAX_MSECS),
+              hasThread(false), thread(0), showThread(false), timeFormat(TIME_OF_DAY), utc(false)
+        {
+        }
+
+        /// is anything filtered at all?
+        bool isEmpty() const
+        {
+            return minLevel == DEBUG && from == 0 && to == MSECS_PER_DAY && !dated && !hasThread;
+        }
+
+        /**
+          Is a message logged at the given time let through?
+          @param msecs the time in ms since the epoch, or -1 if only the
+          time of day is known.
+          @param msecOfDay the time of day in ms since midnight.
+          */
+        bool matchesTime(qint64 msecs, int msecOfDay) const
+        {
+            if(dated) {
+                if(msecs >= 0)
+                    return msecs >= fromDate && msecs < toDate;
+                // a text log with only the time of day can not tell the days
+                // apart, so a range of a day or more lets every time through.
+                if(toDate - fromDate >= MSECS_PER_DAY)
+                    return true;
+            }
+            // a range ending before it starts wraps past midnight
+            if(from <= to)
+                return msecOfDay >= from && msecOfDay < to;
+            return msecOfDay >= from || msecOfDay < to;
+        }
+
+        /// the lowest level to let through.
+        int minLevel;
+        /// the time of day range to let through, in ms since midnight.
+        int from;
+        int to;
+        /// were dates given along with the times?
+        bool dated;
+        /// the range to let through if so, in ms since the epoch.
+        qint64 fromDate;
+        qint64 toDate;
+        /// the thread to let through, if any.
+        bool hasThread;
+        quint64 thread;
+        /// shall the thread be included in the output?
+        bool showThread;
+        /// how to print the time of binary records.
+        TimeFormat timeFormat;
+        /// shall the time of binary records be printed, and filtered, in UTC?
+        bool utc;
+    };
+
+    void usage()
+    {
+        fprintf(stderr,
+                "Usage: logdecode [options] <logfile>\n"
+                "Decodes a binary log written by Logger into text, and filters\n"
+                "binary, text and JSON Lines logs.\n"
+                "\n"
+                "Options:\n"
+                "  -l, --level LEVEL    only show LEVEL and above (DEBUG, INFO, WARNING, CRITICAL)\n"
+                "  -f, --from TIME      only show messages logged at or after TIME\n"
+                "  -u, --to TIME        only show messages logged before TIME\n"
+                "  -t, --thread ID      only show messages from this thread (binary logs only)\n"
+                "  -s, --show-thread    include the thread of each message (binary logs only)\n"
+                "  -T, --time FORMAT    print times as TIME, ISO_MS, ISO_US or EPOCH_NS (binary logs only)\n"
+                "  -z, --utc            print and filter times in UTC (binary logs only)\n"
+                "\n"
+                "TIME is a time of day, HH:MM[:SS], or a date and time, YYYY-MM-DD HH:MM[:SS].\n"
+                "A range of times of day ending before it starts wraps past midnight.\n");
+    }
+
+    int parseLevel(const char *name)
+    {
+        for(int i = DEBUG; i <= NONE; i++) {
+            if(!qstrcmp(name, levelNames[i]))
+                return i;
+        }
+        return -1;
+    }
+
+    /**
+      Parses the name of a time format, as used in the settings.
+      @returns false if the name is unknown.
+      */
+    bool parseTimeFormat(const char *name, TimeFormat &format)
+    {
+        const char *names[] = { "TIME", "ISO_MS", "ISO_US", "EPOCH_NS" };
+        for(int i = TIME_OF_DAY; i <= EPOCH_NANOSECONDS; i++) {
+            if(!qstrcmp(name, names[i])) {
+                format = TimeFormat(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+      Returns the time of day of a time in ns since the epoch, in ms since midnight.
+      */
+    int timeOfDay(qint64 time, bool utc)
+    {
+        qint64 second = time / NSECS_PER_SEC;
+        QDateTime dateTime = QDateTime::fromTime_t(uint(second));
+        if(utc)
+            dateTime = dateTime.toUTC();
+        QTime local = dateTime.time();
+        return ((local.hour() * 60 + local.minute()) * 60 + local.second()) * 1000
+                + int(time / NSECS_PER_MSEC - second * 1000);
+    }
+
+    /**
+      Parses HH:MM[:SS] into ms since midnight, or -1 if it can not be parsed.
+      */
+    int parseTimeOfDay(const char *text)
+    {
+        int hours = 0;
+        int minutes = 0;
+        int seconds = 0;
+        if(sscanf(text, "%d:%d:%d", &hours, &minutes, &seconds) < 2)
+            return -1;
+        if(hours < 0 || hours > 24 || minutes < 0 || minutes > 59 || seconds < 0 || seconds > 59)
+            return -1;
+        return ((hours * 60 + minutes) * 60 + seconds) * 1000;
+    }
+
+    /**
+      Returns a date and time in ms since the epoch.
+      */
+    qint64 toMsecs(const QDate &date, int msecOfDay, bool utc)
+    {
+        // 24:00 is the midnight ending the day
+        if(msecOfDay >= MSECS_PER_DAY)
+            return toMsecs(date.addDays(1), msecOfDay - MSECS_PER_DAY, utc);
+        QDateTime dateTime(date, QTime(0, 0).addMSecs(msecOfDay), utc ? Qt::UTC : Qt::LocalTime);
+        return qint64(dateTime.toTime_t()) * 1000 + msecOfDay % 1000;
+    }
+
+    /**
+      Parses a time given on the command line: HH:MM[:SS], optionally
+      preceded by YYYY-MM-DD and a space or a T.
+      @param text the time to parse.
+      @param utc is the time in UTC rather than local time?
+      @param msecOfDay set to the time of day in ms since midnight.
+      @param msecs set to the time in ms since the epoch if a date was given, or -1.
+      @return false if the time can not be parsed.
+      */
+    bool parseTime(const char *text, bool utc, int &msecOfDay, qint64 &msecs)
+    {
+        int year;
+        int month;
+        int day;
+        int length = 0;
+        msecs = -1;
+        if(sscanf(text, "%4d-%2d-%2d%n", &year, &month, &day, &length) == 3 && length == 10) {
+            if(text[length] != ' ' && text[length] != 'T')
+                return false;
+            QDate date(year, month, day);
+            msecOfDay = parseTimeOfDay(text + length + 1);
+            if(!date.isValid() || msecOfDay < 0)
+                return false;
+            msecs = toMsecs(date, msecOfDay, utc);
+            return true;
+        }
+        msecOfDay = parseTimeOfDay(text);
+        return msecOfDay >= 0;
+    }
+
+    bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    /**
+      Formats the time of binary records. Timestamp only breaks the time
+      down when the second changes, and so does the time of day kept here.
+      */
+    class TimeFormatter {
+    public:
+        TimeFormatter(TimeFormat format, bool utc)
+            : m_format(format), m_utc(utc), m_second(-1), m_msecOfDay(0), m_msec(0)
+        {
+            m_text[0] = '\0';
+        }
+
+        /// updates the formatted time to the given time in ns since the epoch.
+        void update(qint64 time)
+        {
+            m_text[0] = '[';
+            char *end = m_text + 1 + Timestamp::format(time, m_format, m_utc, m_text + 1);
+            *end++ = ']';
+            *end++ = ' ';
+            *end = '\0';
+
+            qint64 second = time / NSECS_PER_SEC;
+            if(second != m_second) {
+                m_second = second;
+                m_msecOfDay = timeOfDay(second * NSECS_PER_SEC, m_utc);
+            }
+            m_msec = int(time / NSECS_PER_MSEC - second * 1000);
+        }
+
+        /// the formatted time, e.g. "[21:04:01] ".
+        const char *text() const
+        {
+            return m_text;
+        }
+
+        /// the time of day in ms since midnight.
+        int msecOfDay() const
+        {
+            return m_msecOfDay + m_msec;
+        }
+
+    private:
+        TimeFormat m_format;
+        bool m_utc;
+        qint64 m_second;
+        int m_msecOfDay;
+        int m_msec;
+        char m_text[Timestamp::MAX_LENGTH + 4];
+    };
+
+    /**
+      Decodes a binary log.
+      @return false if the log is damaged.
+      */
+    bool decodeBinary(const char *data, qint64 size, const Filter &filter, FILE *out)
+    {
+        QHash<quint32, QByteArray> formats;
+        TimeFormatter time(filter.timeFormat, filter.utc);
+        BinaryLog::RecordHeader header;
+        const char *unknownFormat = "<unknown format>";
+        char threadText[32];
+
+        qint64 offset = sizeof(BinaryLog::FileHeader);
+        while(offset + qint64(sizeof(header)) <= size) {
+            memcpy(&header, data + offset, sizeof(header));
+            // a zero size marks space preallocated but never written
+            if(!header.size)
+                return true;
+            if(header.size < sizeof(header) || offset + header.size > size)
+                return false;
+
+            const char *payload = data + offset + sizeof(header);
+            int payloadSize = header.size - sizeof(header);
+            offset += header.size;
+
+            if(header.type == BinaryLog::FormatRecord) {
+                formats.insert(header.formatId, QByteArray(payload, payloadSize));
+                continue;
+            }
+            if(header.type != BinaryLog::MessageRecord || header.level >= NONE)
+                continue;
+
+            if(header.level < filter.minLevel)
+                continue;
+            if(filter.hasThread && header.thread != filter.thread)
+                continue;
+            time.update(header.time);
+            if(!filter.matchesTime(header.time / NSECS_PER_MSEC, time.msecOfDay()))
+                continue;
+
+            fputs(time.text(), out);
+            fputs(levelTags[header.level], out);
+            if(filter.showThread) {
+                qsnprintf(threadText, sizeof(threadText), "[0x%llx] ", (unsigned long long)header.thread);
+                fputs(threadText, out);
+            }
+            if(header.level == DEBUG) {
+                for(int i = 0; i < header.indent; i++)
+                    fputc(' ', out);
+            }
+
+            if(!header.formatId) {
+                fwrite(payload, 1, payloadSize, out);
+            }
+            else {
+                QHash<quint32, QByteArray>::const_iterator format = formats.constFind(header.formatId);
+                if(format == formats.constEnd()) {
+                    fputs(unknownFormat, out);
+                }
+                else {
+                    QByteArray message = BinaryLog::formatArguments(format.value().constData(),
+                                                                    payload, payloadSize);
+                    fwrite(message.constData(), 1, message.size(), out);
+                }
+            }
+            fputc('\n', out);
+        }
+
+        return offset == size;
+    }
+
+    /**
+      Remembers the date and second last turned into a time since the epoch,
+      as that only changes once a second and is costly to work out.
+      */
+    struct DateCache {
+        DateCache()
+            : utc(false), msecs(-1)
+        {
+            memset(text, 0, sizeof(text));
+        }
+
+        /// the text of the date and second, e.g. "2011-06-01T21:04:01".
+        char text[19];
+        /// is it in UTC?
+        bool utc;
+        /// the time in ms since the epoch.
+        qint64 msecs;
+    };
+
+    /**
+      Parses a number of exactly the given number of digits, or returns -1.
+      */
+    int parseDigits(const char *p, int count)
+    {
+        int value = 0;
+        for(int i = 0; i < count; i++) {
+            if(!isDigit(p[i]))
+                return -1;
+            value = value * 10 + (p[i] - '0');
+        }
+        return value;
+    }
+
+    /**
+      Parses three digits following a point into ms, or returns 0 if they do not.
+      */
+    int parseMsecs(const char *p, const char *end)
+    {
+        if(end - p < 4 || p[0] != '.' || !isDigit(p[1]) || !isDigit(p[2]) || !isDigit(p[3]))
+            return 0;
+        return (p[1] - '0') * 100 + (p[2] - '0') * 10 + (p[3] - '0');
+    }
+
+    /**
+      Finds the level and time of a line of a text or JSON Lines log.
+      @param msecs set to the time in ms since the epoch if the line has a
+      date and a cache is given, or -1.
+      @param cache the dates parsed so far, or 0 if the date is not needed.
+      @return false if the line does not start a message, e.g. because it
+      continues a multi-line message.
+      */
+    bool parseTextLine(const char *line, const char *end, int &level, int &msecOfDay,
+                       qint64 &msecs, DateCache *cache)
+    {
+        msecs = -1;
+
+        // the timestamp is between the brackets of a text line, and is the
+        // first member of a JSON line, followed by the level.
+        const char *stamp;
+        const char *close;
+        bool json = end - line > JSON_TIME_LENGTH && !memcmp(line, JSON_TIME, JSON_TIME_LENGTH);
+        if(json) {
+            stamp = line + JSON_TIME_LENGTH;
+            close = static_cast<const char *>(memchr(stamp, '"', end - stamp));
+            if(!close)
+                return false;
+        }
+        else {
+            if(line == end || *line != '[')
+                return false;
+            stamp = line + 1;
+            close = static_cast<const char *>(memchr(line, ']', end - line));
+            if(!close || end - close < 3 || close[1] != ' ' || close[2] != '[')
+                return false;
+        }
+
+        // the time of day is the first HH:MM:SS in the timestamp
+        msecOfDay = -1;
+        for(const char *p = stamp; p + 8 <= close; p++) {
+            if(isDigit(p[0]) && isDigit(p[1]) && p[2] == ':' && isDigit(p[3]) && isDigit(p[4])
+                    && p[5] == ':' && isDigit(p[6]) && isDigit(p[7])) {
+                int hours = (p[0] - '0') * 10 + (p[1] - '0');
+                int minutes = (p[3] - '0') * 10 + (p[4] - '0');
+                int seconds = (p[6] - '0') * 10 + (p[7] - '0');
+                msecOfDay = ((hours * 60 + minutes) * 60 + seconds) * 1000;
+                // with the date in front of it, as written by the ISO formats
+                if(cache && p - stamp >= 11 && p[-1] == 'T' && p[-7] == '-' && p[-4] == '-') {
+                    const char *date = p - 11;
+                    bool utc = memchr(p, 'Z', close - p) != 0;
+                    if(utc != cache->utc || memcmp(date, cache->text, sizeof(cache->text))) {
+                        QDate day(parseDigits(date, 4), parseDigits(date + 5, 2), parseDigits(date + 8, 2));
+                        memcpy(cache->text, date, sizeof(cache->text));
+                        cache->utc = utc;
+                        cache->msecs = day.isValid() ? toMsecs(day, msecOfDay, utc) : -1;
+                    }
+                    if(cache->msecs >= 0)
+                        msecs = cache->msecs + parseMsecs(p + 8, close);
+                }
+                break;
+            }
+        }
+        // or the whole timestamp, if it is in nanoseconds since the epoch
+        if(msecOfDay < 0 && close > stamp) {
+            qint64 time = 0;
+            const char *p = stamp;
+            while(p < close && isDigit(*p))
+                time = time * 10 + (*p++ - '0');
+            if(p == close) {
+                msecOfDay = timeOfDay(time, false);
+                msecs = time / NSECS_PER_MSEC;
+            }
+        }
+        if(msecOfDay < 0)
+            return false;
+
+        if(json) {
+            if(end - close - 1 < JSON_LEVEL_LENGTH || memcmp(close + 1, JSON_LEVEL, JSON_LEVEL_LENGTH))
+                return false;
+            const char *name = close + 1 + JSON_LEVEL_LENGTH;
+            for(level = DEBUG; level < NONE; level++) {
+                int length = qstrlen(levelNames[level]);
+                if(end - name > length && !memcmp(name, levelNames[level], length) && name[length] == '"')
+                    return true;
+            }
+            return false;
+        }
+
+        const char *tag = close + 2;
+        for(level = DEBUG; level < NONE; level++) {
+            int length = qstrlen(levelTags[level]);
+            if(end - tag >= length && !memcmp(tag, levelTags[level], length))
+                return true;
+        }
+        return false;
+    }
+
+    /**
+      Filters a text or JSON Lines log. Lines which do not start a message
+      share the fate of the message they belong to.
+      */
+    void filterText(const char *data, qint64 size, const Filter &filter, FILE *out)
+    {
+        if(filter.isEmpty()) {
+            fwrite(data, 1, size, out);
+            return;
+        }
+
+        const char *end = data + size;
+        const char *line = data;
+        bool show = false;
+        DateCache cache;
+        while(line < end) {
+            const char *newline = static_cast<const char *>(memchr(line, '\n', end - line));
+            const char *next = newline ? newline + 1 : end;
+
+            int level;
+            int msecOfDay;
+            qint64 msecs;
+            if(parseTextLine(line, newline ? newline : end, level, msecOfDay, msecs,
+                             filter.dated ? &cache : 0))
+                show = level >= filter.minLevel && filter.matchesTime(msecs, msecOfDay);
+
+            if(show)
+                fwrite(line, 1, next - line, out);
+            line = next;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Filter filter;
+    const char *path = 0;
+    // parsed once the options are known, as --utc may follow them
+    const char *from = 0;
+    const char *to = 0;
+
+    for(int i = 1; i < argc; i++) {
+        QByteArray arg(argv[i]);
+        bool hasValue = i + 1 < argc;
+        if((arg == "-l" || arg == "--level") && hasValue) {
+            filter.minLevel = parseLevel(argv[++i]);
+            if(filter.minLevel < 0) {
+                fprintf(stderr, "logdecode: unknown level %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if((arg == "-f" || arg == "--from") && hasValue) {
+            from = argv[++i];
+        }
+        else if((arg == "-u" || arg == "--to") && hasValue) {
+            to = argv[++i];
+        }
+        else if((arg == "-t" || arg == "--thread") && hasValue) {
+            bool ok;
+            filter.thread = QByteArray(argv[++i]).toULongLong(&ok, 0);
+            filter.hasThread = true;
+            if(!ok) {
+                fprintf(stderr, "logdecode: invalid thread %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(arg == "-s" || arg == "--show-thread") {
+            filter.showThread = true;
+        }
+        else if((arg == "-T" || arg == "--time") && hasValue) {
+            if(!parseTimeFormat(argv[++i], filter.timeFormat)) {
+                fprintf(stderr, "logdecode: unknown time format %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(arg == "-z" || arg == "--utc") {
+            filter.utc = true;
+        }
+        else if(arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        }
+        else if(!path && !arg.startsWith("-")) {
+            path = argv[i];
+        }
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if(!path) {
+        usage();
+        return 1;
+    }
+
+    qint64 fromDate = -1;
+    qint64 toDate = -1;
+    if(from && !parseTime(from, filter.utc, filter.from, fromDate)) {
+        fprintf(stderr, "logdecode: invalid time %s\n", from);
+        return 1;
+    }
+    if(to && !parseTime(to, filter.utc, filter.to, toDate)) {
+        fprintf(stderr, "logdecode: invalid time %s\n", to);
+        return 1;
+    }
+    if(fromDate >= 0 || toDate >= 0) {
+        if((from && fromDate < 0) || (to && toDate < 0)) {
+            fprintf(stderr, "logdecode: give a date with both --from and --to, or with neither\n");
+            return 1;
+        }
+        filter.dated = true;
+        if(fromDate >= 0)
+            filter.fromDate = fromDate;
+        if(toDate >= 0)
+            filter.toDate = toDate;
+        // text logs with only the time of day are filtered by the times of day
+        if(!from)
+            filter.from = 0;
+        if(!to)
+            filter.to = MSECS_PER_DAY;
+    }
+
+    QFile file(QString::fromLocal8Bit(path));
+    if(!file.open(QIODevice::ReadOnly)) {
+        fprintf(stderr, "logdecode: could not open %s: %s\n", path, qPrintable(file.errorString()));
+        return 1;
+    }
+
+    qint64 size = file.size();
+    if(!size)
+        return 0;
+
+    const char *data = reinterpret_cast<const char *>(file.map(0, size));
+    if(!data) {
+        fprintf(stderr, "logdecode: could not map %s: %s\n", path, qPrintable(file.errorString()));
+        return 1;
+    }
+
+    // large writes to stdout, rather than one per line
+    static char outputBuffer[1 << 20];
+    setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+
+    int result = 0;
+    if(BinaryLog::isValid(data, size)) {
+        if(!decodeBinary(data, size, filter, stdout)) {
+            fprintf(stderr, "logdecode: %s is damaged or truncated\n", path);
+            result = 2;
+        }
+    }
+    else if(RingFile::isRing(data, size)) {
+        QByteArray text = RingFile::unwrap(data, size);
+        filterText(text.constData(), text.size(), filter, stdout);
+    }
+    else {
+        if(filter.hasThread || filter.showThread)
+            fprintf(stderr, "logdecode: %s is not a binary log, threads are only filtered and shown "
+                    "in those\n", path);
+        filterText(data, size, filter, stdout);
+    }
+
+    fflush(stdout);
+    return result;
+}
@@ -0,0 +1,98 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogFields.
+  */
+#include "logfields.h"
+
+LogFields &LogFields::add(const char *key, const char *value)
+{
+    appendKey(key);
+    JsonFormat::appendString(m_json, value);
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, const QString &value)
+{
+    appendKey(key);
+    JsonFormat::appendString(m_json, value);
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, int value)
+{
+    appendKey(key);
+    JsonFormat::appendNumber(m_json, qint64(value));
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, uint value)
+{
+    appendKey(key);
+    JsonFormat::appendNumber(m_json, quint64(value));
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, qint64 value)
+{
+    appendKey(key);
+    JsonFormat::appendNumber(m_json, value);
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, quint64 value)
+{
+    appendKey(key);
+    JsonFormat::appendNumber(m_json, value);
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, long value)
+{
+    return add(key, qint64(value));
+}
+
+LogFields &LogFields::add(const char *key, unsigned long value)
+{
+    return add(key, quint64(value));
+}
+
+LogFields &LogFields::add(const char *key, double value)
+{
+    appendKey(key);
+    JsonFormat::appendNumber(m_json, value);
+    return *this;
+}
+
+LogFields &LogFields::add(const char *key, bool value)
+{
+    appendKey(key);
+    JsonFormat::appendBool(m_json, value);
+    return *this;
+}
+
+void LogFields::appendKey(const char *key)
+{
+    if(!m_json.isEmpty())
+        m_json.append(',');
+    JsonFormat::appendString(m_json, key);
+    m_json.append(':');
+}
@@ -0,0 +1,133 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogFields, the key/value fields of a structured message.
+  */
+
+#ifndef LOGFIELDS_H
+#define LOGFIELDS_H
+
+#include <QString>
+
+#include "export.h"
+#include "jsonformat.h"
+#include "logger.h"
+
+/**
+  The typed key/value fields of a structured log message, e.g.
+  LOG_FIELDS(INFO, "Request served", LogFields().add("path", path).add("ms", elapsed)).
+  Every value is serialised as JSON the moment it is added, into a buffer
+  whose inline part holds the fields of most messages, so building the
+  fields allocates nothing and no QVariant is involved. In the JSON format
+  the fields become members of the line's object; in the text and binary
+  formats they follow the message between braces.
+  The keys are expected to be plain ASCII names and are not checked for
+  duplicates.
+  */
+class LOGGER_EXPORT LogFields
+{
+public:
+    /**
+      Adds a string field.
+      @param key the name of the field.
+      @param value the value, as NUL terminated UTF-8.
+      @returns the fields, so that calls can be chained.
+      */
+    LogFields &add(const char *key, const char *value);
+    /**
+      Adds a string field.
+      */
+    LogFields &add(const char *key, const QString &value);
+    /**
+      Adds an integer field.
+      */
+    LogFields &add(const char *key, int value);
+    /**
+      Adds an unsigned integer field.
+      */
+    LogFields &add(const char *key, uint value);
+    /**
+      Adds a 64 bit integer field.
+      */
+    LogFields &add(const char *key, qint64 value);
+    /**
+      Adds an unsigned 64 bit integer field.
+      */
+    LogFields &add(const char *key, quint64 value);
+    /**
+      Adds a long integer field, e.g. a time_t.
+      */
+    LogFields &add(const char *key, long value);
+    /**
+      Adds an unsigned long integer field, e.g. a size_t.
+      */
+    LogFields &add(const char *key, unsigned long value);
+    /**
+      Adds a floating point field.
+      */
+    LogFields &add(const char *key, double value);
+    /**
+      Adds a boolean field.
+      */
+    LogFields &add(const char *key, bool value);
+
+    /**
+      Removes all fields, keeping the memory for reuse.
+      */
+    void clear() { m_json.resize(0); }
+
+    /**
+      Returns true if no field has been added.
+      */
+    bool isEmpty() const { return m_json.isEmpty(); }
+
+    /**
+      Returns the fields as the members of a JSON object, without the braces,
+      e.g. "path":"/index.html","ms":12.
+      */
+    const char *data() const { return m_json.constData(); }
+
+    /**
+      Returns the length of data().
+      */
+    int size() const { return m_json.size(); }
+
+private:
+    /**
+      Starts a new field, up to the colon.
+      */
+    void appendKey(const char *key);
+
+    /// the fields serialised so far.
+    JsonFormat::Buffer m_json;
+};
+
+/**
+  Logs a message with structured fields, provided the level is enabled.
+  Like LOG_AT, the fields are not built at all if nobody wants the message.
+  */
+#define LOG_FIELDS(level, message, fields) \
+    do { \
+        if(Logger::isEnabled(level)) \
+            Logger::logFieldsAt(level, message, fields); \
+    } while(0)
+
+#endif // LOGFIELDS_H
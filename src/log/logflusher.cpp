@@ -0,0 +1,70 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogFlusher.
+  */
+#include "logflusher.h"
+#include "logger.h"
+
+#include <QMutexLocker>
+
+LogFlusher::LogFlusher(Logger *logger)
+    : m_logger(logger), m_stopping(false)
+{
+}
+
+LogFlusher::~LogFlusher()
+{
+    stop();
+}
+
+void LogFlusher::wake()
+{
+    QMutexLocker locker(&m_mutex);
+    m_wake.wakeOne();
+}
+
+void LogFlusher::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_wake.wakeOne();
+    }
+    wait();
+}
+
+void LogFlusher::run()
+{
+    int interval = 0;
+
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            if(!m_stopping && interval)
+                m_wake.wait(&m_mutex, interval);
+            if(m_stopping)
+                break;
+        }
+
+        interval = m_logger->flushExpired();
+    }
+}
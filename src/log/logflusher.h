@@ -0,0 +1,82 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogFlusher, the thread writing out idle per-thread buffers.
+  */
+
+#ifndef LOGFLUSHER_H
+#define LOGFLUSHER_H
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+class Logger;
+
+/**
+  A thread which has the Logger write out the output staged by threads
+  which have stopped logging, so that it does not wait for their next
+  message to reach the log file. Like ConfigWatcher it polls, so the
+  Logger needs neither to be a QObject nor an event loop in the application.
+  How long it sleeps is decided by the Logger after each check.
+  */
+class LogFlusher : public QThread
+{
+public:
+    /**
+      Constructor.
+      @param logger the Logger to flush.
+      */
+    explicit LogFlusher(Logger *logger);
+    /**
+      Destructor.
+      Stops the thread.
+      */
+    ~LogFlusher();
+
+    /**
+      Has the thread check again at once, as the intervals have changed.
+      */
+    void wake();
+
+    /**
+      Stops the thread, and returns once it has finished.
+      */
+    void stop();
+
+protected:
+    /**
+      The main loop of the flusher thread.
+      */
+    void run();
+
+private:
+    /// the logger to flush.
+    Logger *m_logger;
+    /// protects the stop flag.
+    QMutex m_mutex;
+    /// signalled when we are asked to check again or to stop.
+    QWaitCondition m_wake;
+    /// set when the thread should exit.
+    bool m_stopping;
+};
+
+#endif // LOGFLUSHER_H
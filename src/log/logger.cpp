@@ -24,41 +24,108 @@
   */
 #include "logger.h"
 
-// for Indent
+// for Indent, Profiler, Tracer and Sampler
 #include "debug.h"
 
-#include <iostream>
+#include "binaryformat.h"
+#include "configwatcher.h"
+#include "consolewriter.h"
+#include "crashhandler.h"
+#include "flightrecorder.h"
+#include "jsonformat.h"
+#include "logbuffer.h"
+#include "logcategory.h"
+#include "logcollapser.h"
+#include "logconfig.h"
+#include "logfields.h"
+#include "logflusher.h"
+#include "logmetrics.h"
+#include "logrecord.h"
+#include "logrotator.h"
+#include "logsink.h"
+#include "logwriter.h"
+#include "mappedfile.h"
+#include "ringfile.h"
+#include "timestamp.h"
+
+#include <cstdarg>
+#include <cstring>
 
 #include <QMutexLocker>
 #include <QSettings>
 #include <QCoreApplication>
 #include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QFile>
 #include <QIODevice>
-#include <QTextStream>
-#include <QTime>
+#include <QThread>
+#include <QThreadPool>
+#include <QThreadStorage>
 
-Logger* Logger::_instance = 0;
+QAtomicPointer<Logger> Logger::_instance(0);
+QAtomicInt Logger::m_handlerCalls(0);
+QMutex Logger::m_writerMutex;
 QMutex Logger::m_creationalMutex;
 QMutex Logger::m_operationalMutex;
-#ifdef Q_OS_LINUX
-//                          Grey   White  Brown    Red
-QString Logger::col[4] = { "01;30", "1", "00;33", "01;31" };
-#endif
+QAtomicInt Logger::m_logThreshold(DEBUG);
+// let everything through until an instance has read the real thresholds
+QAtomicInt Logger::m_enabledThreshold(DEBUG);
+namespace {
+    typedef QHash<const char *, quint32> FormatIds;
+    /// the id of every format string used in the binary format, starting at 1.
+    FormatIds formatIds;
+    /// the format strings, in the order they were given ids.
+    QList<const char *> formats;
+    /// a lock-free cache of formatIds for each thread.
+    QThreadStorage<FormatIds *> localFormatIds;
+
+    /// the names of the levels, as stored in the settings.
+    const char *const levelNames[] = { "DEBUG", "INFO", "WARNING", "CRITICAL", "NONE" };
+
+    /**
+      Returns the level with the given name, or the fallback if there is none.
+      */
+    int levelFromName(const QString &name, int fallback)
+    {
+        for(int i = DEBUG; i <= NONE; i++) {
+            if(name == levelNames[i])
+                return i;
+        }
+        return fallback;
+    }
+
+    /// the names of the overflow policies, as stored in the settings.
+    const char *const overflowNames[] = { "BLOCK", "DROP_NEWEST", "DROP_OLDEST", "DROP_BELOW_WARNING" };
+}
 
 Logger* Logger::instance() throw()
 {
+    // Once created, the instance is read without locking. It is only
+    // published after it has been constructed, with an ordered store, and
+    // everything read through it depends on the pointer, so a plain load
+    // is enough (Qt 4 has no load-acquire; Q_GLOBAL_STATIC does the same).
+    Logger *logger = _instance;
+    if(logger)
+        return logger;
+
     QMutexLocker locker(&m_creationalMutex);
-    if(_instance == 0) {
-        _instance = new Logger();
-    }
+    if(!_instance)
+        _instance.fetchAndStoreOrdered(new Logger());
     return _instance;
 }
 
 void Logger::close()
 {
-    delete _instance;
-    _instance = 0;
+    QMutexLocker locker(&m_creationalMutex);
+
+    // unpublish the instance, so the message handler can no longer find it,
+    Logger *logger = _instance.fetchAndStoreOrdered(0);
+    // then wait for the handler calls which already did.
+    while(m_handlerCalls != 0)
+        QThread::yieldCurrentThread();
+
+    delete logger;
 }
 
 void Logger::log(LogLevel level, QString message) throw()
@@ -66,31 +133,293 @@ void Logger::log(LogLevel level, QString message) throw()
     if(!logFile.isOpen())
         return;
 
-    QMutexLocker locker(&m_operationalMutex);
+    // do we bother with formatting and logging?
+    if(!isEnabled(level)) {
+        MetricsCollector::countFiltered(level);
+        return;
+    }
 
-    // do we bother with opening the stream and logging?
-    if(level < m_logThreshold)
+    logMessage(0, level, message);
+}
+
+void Logger::log(const LogCategory &category, LogLevel level, QString message) throw()
+{
+    if(!logFile.isOpen())
         return;
 
-    // shall we limit the logfile?
-    if(m_logLimit) {
-        if(m_linesLogged >= m_logLimit) {
-            // truncate the log file
-            if(!logFile.resize(0))
+    if(!category.isEnabled(level)) {
+        MetricsCollector::countFiltered(level);
+        return;
+    }
+
+    logMessage(&category, level, QString::fromLatin1(category.name()) + ": " + message);
+}
+
+void Logger::log(LogLevel level, const char *message, const LogFields &fields) throw()
+{
+    if(!logFile.isOpen())
+        return;
+
+    if(!isEnabled(level)) {
+        MetricsCollector::countFiltered(level);
+        return;
+    }
+
+    // in the common synchronous case with nothing but a JSON file to write
+    // to, render the line straight from the text and the fields.
+    const LogConfig *config = this->config();
+    if(!(LogWriter *)m_writer && !(FlightRecorder *)m_recorder && m_sinkCount == 0
+       && !config->repeatInterval && !config->logToConsole && level >= m_logThreshold
+       && outputFormat() == JSON_FORMAT) {
+        QByteArray line = JsonFormat::renderMessage(level, LogRecord::currentTime(), LogRecord::currentThread(),
+                                                    Debug::Indent::getIndent(), message,
+                                                    fields.data(), fields.size(),
+                                                    config->timeFormat, config->timeUtc);
+        MetricsCollector::countAccepted(level);
+        if(config->bufferSize) {
+            LogBuffer::append(this, line, QByteArray(), JSON_FORMAT, config->bufferSize, config->flushInterval);
+            return;
+        }
+
+        MetricsLocker locker(&m_operationalMutex, m_metrics);
+        // the file may have been reopened in another format meanwhile
+        if(m_fileFormat == JSON_FORMAT) {
+            writeOutput(line, QByteArray(), 1);
+        }
+        else {
+            LogRecord record(level, QString::fromUtf8(message), Debug::Indent::getIndent());
+            record.fields = QByteArray(fields.data(), fields.size());
+            writeUnfiltered(record);
+        }
+        flushOutput();
+        return;
+    }
+
+    logMessage(0, level, QString::fromUtf8(message), QByteArray(fields.data(), fields.size()));
+}
+
+void Logger::logMessage(const LogCategory *category, LogLevel level, const QString &message,
+                        const QByteArray &fields)
+{
+    LogRecord record(level, message, Debug::Indent::getIndent());
+    record.category = category;
+    record.fields = fields;
+    if(captureRecord(record))
+        return;
+
+    // hold back repeats of the previous message
+    int repeatInterval = config()->repeatInterval;
+    if(repeatInterval && LogCollapser::collapse(this, level, message, 0, fields, repeatInterval))
+        return;
+
+    if(writesBinary())
+        record.encoded = BinaryLog::encodeMessage(record);
+
+    dispatch(record);
+}
+
+void Logger::logf(LogLevel level, const char *format, ...) throw()
+{
+    va_list ap;
+    va_start(ap, format);
+    vlogf(level, format, ap);
+    va_end(ap);
+}
+
+void Logger::vlogf(LogLevel level, const char *format, va_list ap)
+{
+    if(!isEnabled(level)) {
+        MetricsCollector::countFiltered(level);
+        return;
+    }
+
+    const LogConfig *config = this->config();
+    if(writesBinary() && !config->logToConsole) {
+        // nobody needs the text, so only store the raw arguments.
+        if(logFile.isOpen()) {
+            LogRecord record(level, QString(), Debug::Indent::getIndent());
+            record.encoded = BinaryLog::encodeMessage(record, formatId(format), format, ap);
+            if(captureRecord(record))
                 return;
-            m_linesLogged = 0;
+            // compare the arguments without the header, which holds the time.
+            if(!config->repeatInterval
+               || !LogCollapser::collapse(this, level, QString(), format,
+                                          record.encoded.mid(sizeof(BinaryLog::RecordHeader)),
+                                          config->repeatInterval))
+                dispatch(record);
+        }
+    }
+    else {
+        QString message;
+        message.vsprintf(format, ap);
+        log(level, message);
+    }
+}
+
+void Logger::logAt(LogLevel level, const char *format, ...) throw()
+{
+    va_list ap;
+    va_start(ap, format);
+    Logger *logger = acquire();
+    logger->vlogf(level, format, ap);
+    release();
+    va_end(ap);
+}
+
+void Logger::logAt(const LogCategory &category, LogLevel level, const char *format, ...) throw()
+{
+    va_list ap;
+    va_start(ap, format);
+    Logger *logger = acquire();
+    logger->vlogf(category, level, format, ap);
+    release();
+    va_end(ap);
+}
+
+void Logger::logFieldsAt(LogLevel level, const char *message, const LogFields &fields) throw()
+{
+    Logger *logger = acquire();
+    logger->log(level, message, fields);
+    release();
+}
+
+Logger *Logger::acquire()
+{
+    // Announce the call before looking up the instance, so close() can not
+    // delete it under our feet. The instance is looked up once per message.
+    forever {
+        m_handlerCalls.ref();
+        Logger *logger = _instance;
+        if(logger)
+            return logger;
+        // there is no instance, create one without holding off close()
+        m_handlerCalls.deref();
+        instance();
+    }
+}
+
+void Logger::release()
+{
+    m_handlerCalls.deref();
+}
+
+bool Logger::captureRecord(const LogRecord &record)
+{
+    FlightRecorder *recorder = m_recorder;
+    if(!recorder)
+        return false;
+
+    if(record.level >= fileThreshold(record)) {
+        // the context goes before the critical message itself
+        if(record.level >= CRITICAL)
+            dumpFlightRecorder();
+        return false;
+    }
+
+    recorder->record(record);
+    // the record was only let through for the recorder, unless a sink wants it.
+    if(record.level >= m_sinkThreshold)
+        return false;
+    MetricsCollector::countFiltered(record.level);
+    return true;
+}
+
+void Logger::logf(const LogCategory &category, LogLevel level, const char *format, ...) throw()
+{
+    va_list ap;
+    va_start(ap, format);
+    vlogf(category, level, format, ap);
+    va_end(ap);
+}
+
+void Logger::vlogf(const LogCategory &category, LogLevel level, const char *format, va_list ap)
+{
+    if(!category.isEnabled(level)) {
+        MetricsCollector::countFiltered(level);
+        return;
+    }
+
+    QString message;
+    message.vsprintf(format, ap);
+    log(category, level, message);
+}
+
+int Logger::fileThreshold(const LogRecord &record) const
+{
+    return record.category ? int(record.category->threshold()) : int(m_logThreshold);
+}
+
+void Logger::dispatch(const LogRecord &record)
+{
+    MetricsCollector::countAccepted(record.level);
+
+    // leave the formatting and writing to the writer thread. A writer which
+    // has been stopped meanwhile refuses the record, so we write it ourselves.
+    LogWriter *writer = m_writer;
+    if(writer && writer->enqueue(record, config()->overflowPolicy))
+        return;
+
+    // stage the output in the calling thread's buffer, unless the record
+    // holds raw arguments and the file is no longer binary: decoding those
+    // takes the operational mutex anyway.
+    const LogConfig *config = this->config();
+    LogFormat format = outputFormat();
+    if(config->bufferSize && (format == BINARY_FORMAT || !encodedFormatId(record))) {
+        QByteArray file;
+        QByteArray console;
+        if(record.level >= fileThreshold(record)) {
+            render(record, format, file, console);
+            LogBuffer::append(this, file, console, format, config->bufferSize, config->flushInterval);
         }
+        // the sinks are not buffered
+        if(m_sinkCount != 0) {
+            MetricsLocker locker(&m_operationalMutex, m_metrics);
+            writeSinks(record, format == TEXT_FORMAT ? file : QByteArray());
+        }
+        return;
     }
 
-    ++m_linesLogged;
+    MetricsLocker locker(&m_operationalMutex, m_metrics);
+    write(record);
+    flushOutput();
+}
+
+void Logger::logRepeats(LogLevel level, int repeats, quint64 thread)
+{
+    if(!logFile.isOpen())
+        return;
+
+    LogRecord record(level, repeats == 1 ? QString("Last message repeated once.")
+                                         : QString("Last message repeated %1 times.").arg(repeats), 0);
+    record.thread = thread;
+    if(writesBinary())
+        record.encoded = BinaryLog::encodeMessage(record);
+    dispatch(record);
+}
 
-    QTextStream stream(&logFile);
+LogRecord Logger::internalRecord(LogLevel level, const QString &message) const
+{
+    LogRecord record(level, message, 0);
+    if(writesBinary())
+        record.encoded = BinaryLog::encodeMessage(record);
+    return record;
+}
 
+QString Logger::format(const LogRecord &record) const
+{
     // print timestamp
-    QString output = "[" + QTime::currentTime().toString() + "] ";
-    switch(level) {
+    char timestamp[Timestamp::MAX_LENGTH + 1];
+    const LogConfig *config = this->config();
+    int length = Timestamp::format(record.time, config->timeFormat, config->timeUtc, timestamp);
+
+    QString output;
+    output.reserve(length + 14 + record.indent + record.message.size());
+    output += '[';
+    output += QLatin1String(timestamp);
+    output += "] ";
+    switch(record.level) {
     case DEBUG:
-        output += "[DEBUG]    " + QString(Debug::Indent::getIndent(), ' ');
+        output += "[DEBUG]    " + QString(record.indent, ' ');
         break;
     case INFO:
         output += "[INFO]     ";
@@ -107,170 +436,1364 @@ void Logger::log(LogLevel level, QString message) throw()
         break;
     }
 
-    output += message + "\n";
-    stream << output;
-#ifdef Q_OS_LINUX
-    if(!qgetenv("LOG_COLOR").isEmpty()) {
-        output.prepend("\x1b[" + col[level] + "m");
-        output.append("\x1b[00;39m");
-    }
-#endif
-    if(m_logToConsole)
-        std::cerr << qPrintable(output);
+    output += record.message;
+    if(!record.fields.isEmpty())
+        output += " {" + QString::fromUtf8(record.fields.constData(), record.fields.size()) + '}';
+    output += '\n';
+    return output;
 }
 
-void Logger::setLogPath(QString dir, QString filename)
+void Logger::render(const LogRecord &record, LogFormat format, QByteArray &file, QByteArray &console) const
 {
-    QMutexLocker locker(&m_operationalMutex);
+    // the record may have been encoded for a file which has since been reopened.
+    if(format != BINARY_FORMAT && encodedFormatId(record)) {
+        render(decodeRecord(record), format, file, console);
+        return;
+    }
 
-    QDir logDir;
-    logDir.setPath(dir);
-    if(!logDir.exists())
-        logDir.mkpath(dir);
+    QString output;
+    const LogConfig *config = this->config();
+    if(format == BINARY_FORMAT) {
+        file = record.encoded.isEmpty() ? BinaryLog::encodeMessage(record) : record.encoded;
+    }
+    else if(format == JSON_FORMAT) {
+        // only valid until the next record, which is fine for the callers.
+        file = JsonFormat::renderRecord(record, config->timeFormat, config->timeUtc);
+    }
+    else {
+        output = this->format(record);
+        file = output.toLocal8Bit();
+    }
 
-    if(logFile.isOpen())
-        logFile.close();
+    if(config->logToConsole) {
+        // the console shares the text of the file, if it is the same.
+        if(output.isNull())
+            console = m_consoleWriter->decorate(record.level, this->format(record), QByteArray());
+        else
+            console = m_consoleWriter->decorate(record.level, output, file);
+    }
+}
 
-    logFile.setFileName(dir + QDir::separator() + filename);
-    logFile.open(QIODevice::ReadWrite | QIODevice::Text | QIODevice::Truncate);
+quint32 Logger::encodedFormatId(const LogRecord &record)
+{
+    BinaryLog::RecordHeader header;
+    if(record.encoded.size() < int(sizeof(header)))
+        return 0;
+    memcpy(&header, record.encoded.constData(), sizeof(header));
+    return header.formatId;
+}
 
-    // store the settings.
-    QSettings settings;
+LogRecord Logger::decodeRecord(const LogRecord &record) const
+{
+    LogRecord decoded = record;
+    decoded.encoded.clear();
+    quint32 id = encodedFormatId(record);
+    if(id && int(id) <= formats.size()) {
+        QByteArray text = BinaryLog::formatArguments(formats.at(id - 1),
+                                                     record.encoded.constData() + sizeof(BinaryLog::RecordHeader),
+                                                     record.encoded.size() - sizeof(BinaryLog::RecordHeader));
+        decoded.message = QString::fromLocal8Bit(text.constData(), text.size());
+    }
+    return decoded;
+}
 
-    settings.setValue("Log/log_path", dir);
-    settings.setValue("Log/log_filename", filename);
+void Logger::write(const LogRecord &record)
+{
+    QByteArray file;
+    QByteArray console;
+    // the record may only have been let through for a sink.
+    if(record.level >= fileThreshold(record)) {
+        render(record, m_fileFormat, file, console);
+        writeOutput(file, console, 1);
+    }
+    if(!m_sinks.isEmpty())
+        writeSinks(record, m_fileFormat == TEXT_FORMAT ? file : QByteArray());
 }
 
-QString Logger::logPath() const
+void Logger::writeUnfiltered(const LogRecord &record)
 {
-    QSettings settings;
-    return settings.value("Log/log_path").toString();
+    QByteArray file;
+    QByteArray console;
+    render(record, m_fileFormat, file, console);
+    writeOutput(file, console, 1);
 }
 
-QString Logger::logFilename() const
+void Logger::writeSinks(const LogRecord &record, const QByteArray &text)
 {
-    QSettings settings;
-    return settings.value("Log/log_filename").toString();
+    // each format is rendered at most once, and only if a sink wants it.
+    QByteArray formatted[3];
+    formatted[TEXT_FORMAT] = text;
+
+    foreach(LogSink *sink, m_sinks) {
+        if(record.level < sink->threshold())
+            continue;
+
+        QByteArray &data = formatted[sink->format()];
+        if(data.isEmpty()) {
+            // sinks get the text of the message rather than the raw arguments,
+            // which refer to format definitions in the log file.
+            LogRecord message = encodedFormatId(record) ? decodeRecord(record) : record;
+
+            if(sink->format() == BINARY_FORMAT) {
+                data = message.encoded.isEmpty() ? BinaryLog::encodeMessage(message) : message.encoded;
+            }
+            else if(sink->format() == JSON_FORMAT) {
+                // a sink may keep the data, so it gets a copy of its own.
+                const LogConfig *config = this->config();
+                data = JsonFormat::encodeRecord(message, config->timeFormat, config->timeUtc);
+            }
+            else
+                data = format(message).toLocal8Bit();
+        }
+        sink->write(record.level, data);
+    }
 }
 
-void Logger::setLogThreshold(LogLevel level)
+void Logger::writeOutput(const QByteArray &file, const QByteArray &console, int lines)
 {
-    m_logThreshold = level;
+    // the log file may have been closed since the output was queued.
+    if(!logFile.isOpen())
+        return;
 
-    // store the setting
-    QSettings s;
-    QVariant value;
+    DebugTimer timer;
 
-    switch(m_logThreshold) {
-    case DEBUG:
-        value = "DEBUG";
-        break;
-    case INFO:
-        value = "INFO";
-        break;
-    case WARNING:
-        value = "WARNING";
-        break;
-    case CRITICAL:
-        value = "CRITICAL";
-        break;
-    case NONE:
-        value = "NONE";
-        break;
+    // a ring file takes care of its own size
+    if(m_ring) {
+        timer.start();
+        if(!m_ring->write(logFile, file))
+            return;
+        m_metrics->countWrite(MetricsCollector::nsecsElapsed(timer), file.size());
+        m_linesLogged += lines;
+        if(!console.isEmpty())
+            m_consoleWriter->write(console);
+        return;
+    }
+
+    // shall we rotate the logfile? A file is never rotated while empty,
+    // so a single message larger than the limit can not make us spin.
+    const LogConfig *config = this->config();
+    if(config->logMaxSize && m_linesLogged
+       && logSize() + file.size() > config->logMaxSize + m_rotationDelay) {
+        rotate();
+        if(!logFile.isOpen())
+            return;
+    }
+
+    // shall we limit the logfile?
+    if(config->logLimit) {
+        if(m_linesLogged && m_linesLogged + lines > config->logLimit) {
+            // truncate the log file
+            if(!(m_mapped ? m_mapped->truncate(logFile) : logFile.resize(0)))
+                return;
+            m_metrics->countTruncation();
+            m_linesLogged = 0;
+            if(m_fileFormat == BINARY_FORMAT)
+                writeFileHeader();
+        }
     }
 
-    s.setValue("Log/log_threshold", value);
+    m_linesLogged += lines;
+
+    timer.start();
+    writeData(file.constData(), file.size());
+    m_metrics->countWrite(MetricsCollector::nsecsElapsed(timer), file.size());
+    if(!console.isEmpty())
+        m_consoleWriter->write(console);
 }
 
-LogLevel Logger::logThreshold() const
+void Logger::writeStaged(const QByteArray &file, const QByteArray &console, int lines,
+                         LogFormat format)
 {
-    return m_logThreshold;
+    MetricsLocker locker(&m_operationalMutex, m_metrics);
+
+    // output in another format would corrupt the file for its readers,
+    // and it can not be rendered anew once staged.
+    if(format != m_fileFormat) {
+        if(logFile.isOpen() && !console.isEmpty())
+            m_consoleWriter->write(console);
+        writeUnfiltered(internalRecord(WARNING, QString("%1 staged messages were discarded, "
+                                                        "as the log file changed format.").arg(lines)));
+    }
+    else {
+        writeOutput(file, console, lines);
+    }
+    flushOutput();
 }
 
-void Logger::setLogToConsole(bool enabled)
+int Logger::flushExpired()
 {
-    m_logToConsole = enabled;
+    // copied, as flushing may wait for the operational mutex for a while
+    const LogConfig *config = this->config();
+    int bufferSize = config->bufferSize;
+    int flushInterval = config->flushInterval;
+    int repeatInterval = config->repeatInterval;
+    int interval = FLUSH_CHECK_INTERVAL;
+
+    if(bufferSize) {
+        LogBuffer::flushExpired(this, flushInterval);
+        // checking twice per interval keeps the delay below one and a half
+        interval = qMin(interval, flushInterval / 2);
+    }
+    if(repeatInterval) {
+        LogCollapser::reportExpired(this, repeatInterval);
+        interval = qMin(interval, repeatInterval / 2);
+    }
+
+    return qMax(interval, (int)MIN_FLUSH_CHECK_INTERVAL);
 }
 
-bool Logger::logToConsole() const
+void Logger::updateFlusher()
 {
-    return m_logToConsole;
+    if(!m_flusher && (config()->bufferSize || config()->repeatInterval)) {
+        m_flusher = new LogFlusher(this);
+        m_flusher->start();
+    }
+    else if(m_flusher) {
+        m_flusher->wake();
+    }
 }
 
-void Logger::setLogLimit(int numLines)
+void Logger::flushOutput()
 {
-    m_logLimit = numLines;
+    DebugTimer timer;
+    timer.start();
+    logFile.flush();
+    m_consoleWriter->flush();
+    m_metrics->countFlush(MetricsCollector::nsecsElapsed(timer));
+
+    // the statistics follow the output they cover
+    if(m_metrics->statisticsDue(config()->statsInterval)) {
+        writeUnfiltered(internalRecord(INFO, currentMetrics().format()));
+        logFile.flush();
+        m_consoleWriter->flush();
+    }
 }
 
-int Logger::logLimit() const
+void Logger::writeBatch(const QList<LogRecord> &records, const QString &report)
 {
-    return m_logLimit;
+    MetricsLocker locker(&m_operationalMutex, m_metrics);
+
+    foreach(const LogRecord &record, records)
+        write(record);
+    // a threshold above WARNING must not hide the loss
+    if(!report.isEmpty())
+        writeUnfiltered(internalRecord(WARNING, report));
+    flushOutput();
 }
 
-void Logger::logMessageHandler(QtMsgType type, const char *msg)
+void Logger::openLogFile(bool truncate)
 {
-    switch(type)
-    {
-    case QtDebugMsg:
-        instance()->log(DEBUG, QString(msg));
-        break;
+    closeLogFile();
 
-    case QtWarningMsg:
-        instance()->log(WARNING, QString(msg));
-        break;
+    m_linesLogged = 0;
+    m_rotationDelay = 0;
+    // records are rendered for the file by the format it was opened in,
+    // and appended to by the format it was written in.
+    const LogConfig *config = this->config();
+    if(truncate)
+        m_fileFormat = outputFormat();
 
-    case QtCriticalMsg:
-        instance()->log(CRITICAL, QString(msg));
-        break;
+    if(config->logRingSize) {
+        // keep what is in an existing ring, it is what we are here for.
+        if(logFile.open(QIODevice::ReadWrite)) {
+            m_ring = new RingFile();
+            if(!m_ring->open(logFile, config->logRingSize)) {
+                delete m_ring;
+                m_ring = 0;
+                logFile.close();
+            }
+        }
+    }
+    else {
+        // no line ending conversion for binary data, nor through a mapping
+        QIODevice::OpenMode mode = QIODevice::ReadWrite;
+        if(truncate)
+            mode |= QIODevice::Truncate;
+        if(m_fileFormat != BINARY_FORMAT && !config->logMapped)
+            mode |= QIODevice::Text;
+        if(!logFile.open(mode))
+            return;
+        if(!truncate)
+            logFile.seek(logFile.size());
+        bool empty = logFile.size() == 0;
 
-    case QtFatalMsg:
-        instance()->log(CRITICAL, QString(msg));
-        // Fatal error, kill the application
-        QCoreApplication::quit();
-        break;
+        if(config->logMapped) {
+            m_mapped = new MappedFile(MAP_CHUNK_SIZE);
+            if(!m_mapped->open(logFile)) {
+                // fall back to writing through the QFile
+                m_mapped->close(logFile);
+                delete m_mapped;
+                m_mapped = 0;
+            }
+        }
+
+        if(m_fileFormat == BINARY_FORMAT && empty)
+            writeFileHeader();
     }
+
+    // the crash handler can only append to a plain file
+    if(logFile.isOpen() && !m_ring && !m_mapped)
+        CrashHandler::setLogFile(logFile.handle());
 }
 
-Logger::Logger() throw()
+void Logger::closeLogFile()
 {
-    // open file(s) for logging, set logging threshold
-    QSettings settings;
-    QString path;
-    QString filename;
-    QString threshold;
-    // log to console by default
-    m_logToConsole = true;
-    // do not limit the logfile by default
-    m_logLimit = 0;
-    m_linesLogged = 0;
-    m_logThreshold = NONE;
-    // by default the path is a dot-folder under the users home directory.
-    path = settings.value("Log/log_path", QVariant(QString("%1%2.%3").arg(QDir::homePath(), QDir::separator(), QCoreApplication::applicationName()))).toString();
-    // default filename is <application name>.log
-    filename = settings.value("Log/log_filename", QVariant(QString("%1.log").arg(QCoreApplication::applicationName()))).toString();
-    // default threshold is WARNING
-    threshold = settings.value("Log/log_threshold", "WARNING").toString();
+    CrashHandler::setLogFile(-1);
 
-    setLogPath(path, filename);
+    if(m_mapped) {
+        m_mapped->close(logFile);
+        delete m_mapped;
+        m_mapped = 0;
+    }
+    delete m_ring;
+    m_ring = 0;
 
-    // set log threshold
-    QString comp[5] = { "DEBUG", "INFO", "WARNING", "CRITICAL", "NONE" };
-    for(int i = 0; i < 5; i++) {
-        if(threshold == comp[i]) {
-            m_logThreshold = (LogLevel)i;
-            break;
-        }
+    if(logFile.isOpen())
+        logFile.close();
+}
+
+void Logger::writeData(const char *data, qint64 length)
+{
+    if(m_mapped && !m_mapped->write(logFile, data, length)) {
+        // the file could not be extended or mapped, so fall back to writing
+        // through the QFile from where the mapped output ended.
+        qint64 size = m_mapped->size();
+        m_mapped->close(logFile);
+        delete m_mapped;
+        m_mapped = 0;
+        logFile.seek(size);
+        CrashHandler::setLogFile(logFile.handle());
     }
+    if(!m_mapped)
+        logFile.write(data, length);
+}
 
-    // Setup the qMsgHandler
-    oldHandler = qInstallMsgHandler(Logger::logMessageHandler);
+qint64 Logger::logSize() const
+{
+    return m_mapped ? m_mapped->size() : logFile.pos();
 }
 
-Logger::~Logger() throw()
+LogFormat Logger::outputFormat() const
 {
-    if(logFile.isOpen())
-        logFile.close();
+    // a ring file overwrites its oldest output, which a binary log can not survive.
+    const LogConfig *config = this->config();
+    if(config->logFormat == BINARY_FORMAT && config->logRingSize)
+        return TEXT_FORMAT;
+    return config->logFormat;
+}
 
-    qInstallMsgHandler(oldHandler);
+bool Logger::writesBinary() const
+{
+    return outputFormat() == BINARY_FORMAT;
+}
+
+void Logger::rotate()
+{
+    QString path = logFile.fileName();
+    // the process id keeps us clear of the files of other processes, and
+    // anything left over, e.g. by a failed compression, is never overwritten.
+    QString rotated;
+    do {
+        rotated = QString("%1.%2-%3.rotated").arg(path).arg(QCoreApplication::applicationPid())
+                                             .arg(++m_rotations);
+    } while(QFile::exists(rotated));
+
+    closeLogFile();
+    if(QFile::rename(path, rotated)) {
+        m_rotationPool->start(new LogRotator(path, rotated, config()->logGenerations));
+        openLogFile();
+        return;
+    }
+
+    // keep the history rather than starting over in the same file, and only
+    // try again once the file has grown by as much once more.
+    openLogFile(false);
+    if(!logFile.isOpen())
+        return;
+    m_rotationDelay = logSize();
+    writeUnfiltered(internalRecord(WARNING, QString("Could not rotate the log file to %1, "
+                                                    "appending to it instead.").arg(rotated)));
+}
+
+void Logger::writeFileHeader()
+{
+    BinaryLog::FileHeader header = BinaryLog::fileHeader();
+    writeData(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // make the file self-contained by repeating every format defined so far
+    for(int i = 0; i < formats.size(); i++) {
+        QByteArray definition = BinaryLog::encodeFormat(i + 1, formats.at(i));
+        writeData(definition.constData(), definition.size());
+    }
+}
+
+quint32 Logger::formatId(const char *format)
+{
+    if(!localFormatIds.hasLocalData())
+        localFormatIds.setLocalData(new FormatIds());
+
+    // look in the cache of the calling thread first, to avoid the lock.
+    FormatIds *ids = localFormatIds.localData();
+    quint32 id = ids->value(format);
+    if(!id) {
+        id = registerFormat(format);
+        ids->insert(format, id);
+    }
+    return id;
+}
+
+quint32 Logger::registerFormat(const char *format)
+{
+    QMutexLocker locker(&m_operationalMutex);
+
+    quint32 id = formatIds.value(format);
+    if(!id) {
+        formats.append(format);
+        id = formats.size();
+        formatIds.insert(format, id);
+        // the definition is written straight away, so it always precedes
+        // messages using it, whichever thread or buffer they go through.
+        if(logFile.isOpen() && m_fileFormat == BINARY_FORMAT) {
+            QByteArray definition = BinaryLog::encodeFormat(id, format);
+            writeData(definition.constData(), definition.size());
+        }
+    }
+    return id;
+}
+
+void Logger::setLogPath(QString dir, QString filename)
+{
+    openLogPath(dir, filename);
+
+    // store the settings.
+    QSettings settings;
+
+    settings.setValue("Log/log_path", dir);
+    settings.setValue("Log/log_filename", filename);
+}
+
+void Logger::openLogPath(const QString &dir, const QString &filename)
+{
+    QMutexLocker locker(&m_operationalMutex);
+
+    QDir logDir;
+    logDir.setPath(dir);
+    if(!logDir.exists())
+        logDir.mkpath(dir);
+
+    logFile.setFileName(dir + QDir::separator() + filename);
+    openLogFile();
+}
+
+QString Logger::logPath() const
+{
+    QSettings settings;
+    return settings.value("Log/log_path").toString();
+}
+
+QString Logger::logFilename() const
+{
+    QSettings settings;
+    return settings.value("Log/log_filename").toString();
+}
+
+void Logger::setLogThreshold(LogLevel level)
+{
+    m_logThreshold = level;
+    updateEnabledThreshold();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_threshold", QString(levelNames[level]));
+}
+
+void Logger::setCategoryThreshold(const QString &name, LogLevel level)
+{
+    LogCategory::setThreshold(name, level);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_category/" + name, QString(levelNames[level]));
+}
+
+void Logger::clearCategoryThreshold(const QString &name)
+{
+    LogCategory::clearThreshold(name);
+
+    QSettings s;
+    s.remove("Log/log_category/" + name);
+}
+
+LogLevel Logger::categoryThreshold(const QString &name) const
+{
+    LogLevel level;
+    if(!LogCategory::threshold(name, level))
+        level = logThreshold();
+    return level;
+}
+
+LogLevel Logger::logThreshold() const
+{
+    return (LogLevel)(int)m_logThreshold;
+}
+
+void Logger::setLogFormat(LogFormat format)
+{
+    // what is staged now is rendered in the old format
+    LogBuffer::flushAll(this);
+
+    QMutexLocker locker(&m_operationalMutex);
+
+    if(format != config()->logFormat) {
+        {
+            QMutexLocker configLocker(&m_configMutex);
+            LogConfig *config = copyConfig();
+            config->logFormat = format;
+            publishConfig(config);
+        }
+        openLogFile();
+    }
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_format", format == BINARY_FORMAT ? "BINARY" : format == JSON_FORMAT ? "JSON" : "TEXT");
+}
+
+LogFormat Logger::logFormat() const
+{
+    return config()->logFormat;
+}
+
+void Logger::setLogTimeFormat(TimeFormat format)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->timeFormat = format;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    QVariant value;
+
+    switch(format) {
+    case TIME_OF_DAY:
+        value = "TIME";
+        break;
+    case ISO_MILLISECONDS:
+        value = "ISO_MS";
+        break;
+    case ISO_MICROSECONDS:
+        value = "ISO_US";
+        break;
+    case EPOCH_NANOSECONDS:
+        value = "EPOCH_NS";
+        break;
+    }
+
+    s.setValue("Log/log_time_format", value);
+}
+
+TimeFormat Logger::logTimeFormat() const
+{
+    return config()->timeFormat;
+}
+
+void Logger::setLogTimeUtc(bool enabled)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->timeUtc = enabled;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_time_utc", enabled);
+}
+
+bool Logger::logTimeUtc() const
+{
+    return config()->timeUtc;
+}
+
+void Logger::setLogToConsole(bool enabled)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->logToConsole = enabled;
+    publishConfig(config);
+}
+
+bool Logger::logToConsole() const
+{
+    return config()->logToConsole;
+}
+
+void Logger::setLogLimit(int numLines)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->logLimit = numLines;
+    publishConfig(config);
+}
+
+int Logger::logLimit() const
+{
+    return config()->logLimit;
+}
+
+void Logger::setLogMaxSize(qint64 numBytes)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->logMaxSize = numBytes;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_max_size", numBytes);
+}
+
+qint64 Logger::logMaxSize() const
+{
+    return config()->logMaxSize;
+}
+
+void Logger::setLogGenerations(int generations)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->logGenerations = generations;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_generations", generations);
+}
+
+int Logger::logGenerations() const
+{
+    return config()->logGenerations;
+}
+
+void Logger::setLogRingSize(qint64 numBytes)
+{
+    // what is staged now is rendered for the old file
+    LogBuffer::flushAll(this);
+
+    QMutexLocker locker(&m_operationalMutex);
+
+    if(numBytes != config()->logRingSize) {
+        {
+            QMutexLocker configLocker(&m_configMutex);
+            LogConfig *config = copyConfig();
+            config->logRingSize = numBytes;
+            publishConfig(config);
+        }
+        openLogFile();
+    }
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_ring_size", numBytes);
+}
+
+qint64 Logger::logRingSize() const
+{
+    return config()->logRingSize;
+}
+
+void Logger::setLogMapped(bool enabled)
+{
+    QMutexLocker locker(&m_operationalMutex);
+
+    if(enabled != config()->logMapped) {
+        {
+            QMutexLocker configLocker(&m_configMutex);
+            LogConfig *config = copyConfig();
+            config->logMapped = enabled;
+            publishConfig(config);
+        }
+        openLogFile();
+    }
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_mapped", enabled);
+}
+
+bool Logger::logMapped() const
+{
+    return config()->logMapped;
+}
+
+void Logger::setLogProfile(bool enabled)
+{
+    Debug::Profiler::setEnabled(enabled);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_profile", enabled);
+}
+
+bool Logger::logProfile() const
+{
+    return Debug::Profiler::isEnabled();
+}
+
+void Logger::setLogTrace(const QString &path)
+{
+    m_logTrace = path;
+    if(path.isEmpty())
+        Debug::Tracer::stop();
+    else if(!Debug::Tracer::start(path))
+        m_logTrace.clear();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_trace", path);
+}
+
+QString Logger::logTrace() const
+{
+    return m_logTrace;
+}
+
+void Logger::setLogSampleEvery(int every)
+{
+    Debug::Sampler::setDefaults(every, Debug::Sampler::defaultPerSecond());
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_sample_every", every);
+}
+
+int Logger::logSampleEvery() const
+{
+    return Debug::Sampler::defaultEvery();
+}
+
+void Logger::setLogSampleRate(int perSecond)
+{
+    Debug::Sampler::setDefaults(Debug::Sampler::defaultEvery(), perSecond);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_sample_rate", perSecond);
+}
+
+int Logger::logSampleRate() const
+{
+    return Debug::Sampler::defaultPerSecond();
+}
+
+void Logger::setAsynchronous(bool enabled)
+{
+    // one change at a time
+    QMutexLocker locker(&m_writerMutex);
+
+    if(enabled && !m_writer) {
+        LogWriter *writer = new LogWriter(this, m_queueSize);
+        writer->start();
+        m_writer.fetchAndStoreOrdered(writer);
+    }
+    else if(!enabled && m_writer) {
+        // stop() writes whatever is left in the queue. Logging threads may
+        // still hold the writer, so it is kept until the Logger is deleted.
+        LogWriter *writer = m_writer.fetchAndStoreOrdered(0);
+        writer->stop();
+        QMutexLocker operationalLocker(&m_operationalMutex);
+        m_retiredWriters.append(writer);
+    }
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_async", enabled);
+}
+
+bool Logger::asynchronous() const
+{
+    return m_writer != 0;
+}
+
+void Logger::setOverflowPolicy(OverflowPolicy policy)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->overflowPolicy = policy;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_overflow", QString(overflowNames[policy]));
+}
+
+OverflowPolicy Logger::overflowPolicy() const
+{
+    return config()->overflowPolicy;
+}
+
+void Logger::setStatisticsInterval(int msecs)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->statsInterval = msecs;
+    publishConfig(config);
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_stats_interval", msecs);
+}
+
+int Logger::statisticsInterval() const
+{
+    return config()->statsInterval;
+}
+
+LogMetrics Logger::metrics() const
+{
+    QMutexLocker locker(&m_operationalMutex);
+    return currentMetrics();
+}
+
+LogMetrics Logger::currentMetrics() const
+{
+    LogMetrics metrics = m_metrics->snapshot();
+    for(int i = DEBUG; i < NONE; i++)
+        metrics.dropped[i] = countDropped(LogLevel(i));
+    LogWriter *writer = m_writer;
+    metrics.queueDepth = writer ? writer->queueDepth() : 0;
+    return metrics;
+}
+
+qint64 Logger::droppedMessages(LogLevel level) const
+{
+    QMutexLocker locker(&m_operationalMutex);
+    return countDropped(level);
+}
+
+qint64 Logger::countDropped(LogLevel level) const
+{
+    if(level < DEBUG || level >= NONE)
+        return 0;
+
+    qint64 dropped = 0;
+    foreach(LogWriter *retired, m_retiredWriters)
+        dropped += retired->dropped(level);
+    LogWriter *writer = m_writer;
+    return writer ? dropped + writer->dropped(level) : dropped;
+}
+
+void Logger::setBufferSize(int numBytes)
+{
+    // write out what was staged under the old size
+    if(!numBytes)
+        LogBuffer::flushAll(this);
+
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->bufferSize = numBytes;
+    publishConfig(config);
+    updateFlusher();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_buffer_size", numBytes);
+}
+
+int Logger::bufferSize() const
+{
+    return config()->bufferSize;
+}
+
+void Logger::setFlushInterval(int msecs)
+{
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->flushInterval = msecs;
+    publishConfig(config);
+    updateFlusher();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_flush_interval", msecs);
+}
+
+int Logger::flushInterval() const
+{
+    return config()->flushInterval;
+}
+
+void Logger::setRepeatInterval(int msecs)
+{
+    // report what was held back under the old interval
+    if(!msecs)
+        LogCollapser::flushAll(this);
+
+    QMutexLocker locker(&m_configMutex);
+    LogConfig *config = copyConfig();
+    config->repeatInterval = msecs;
+    publishConfig(config);
+    updateFlusher();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_repeat_interval", msecs);
+}
+
+int Logger::repeatInterval() const
+{
+    return config()->repeatInterval;
+}
+
+void Logger::addSink(LogSink *sink)
+{
+    QMutexLocker locker(&m_operationalMutex);
+    if(m_sinks.contains(sink))
+        return;
+    m_sinks.append(sink);
+    sink->m_logger = this;
+    m_sinkCount.ref();
+    updateEnabledThresholdLocked();
+}
+
+void Logger::removeSink(LogSink *sink)
+{
+    QMutexLocker locker(&m_operationalMutex);
+    if(detachSink(sink))
+        updateEnabledThresholdLocked();
+}
+
+bool Logger::detachSink(LogSink *sink)
+{
+    if(!m_sinks.removeOne(sink))
+        return false;
+    sink->m_logger = 0;
+    m_sinkCount.deref();
+    return true;
+}
+
+QList<LogSink *> Logger::sinks() const
+{
+    QMutexLocker locker(&m_operationalMutex);
+    return m_sinks;
+}
+
+void Logger::updateEnabledThreshold()
+{
+    QMutexLocker locker(&m_operationalMutex);
+    updateEnabledThresholdLocked();
+}
+
+void Logger::updateEnabledThresholdLocked()
+{
+    int sinks = NONE;
+    foreach(LogSink *sink, m_sinks)
+        sinks = qMin(sinks, int(sink->threshold()));
+    m_sinkThreshold = sinks;
+
+    // the flight recorder wants everything
+    int others = m_recorder ? int(DEBUG) : sinks;
+    m_enabledThreshold = qMin(int(m_logThreshold), others);
+    LogCategory::setDefaults(m_logThreshold, others);
+}
+
+void Logger::setFlightRecorderSize(int records)
+{
+    FlightRecorder *recorder = records > 0 ? new FlightRecorder(records) : 0;
+    {
+        QMutexLocker locker(&m_operationalMutex);
+        // other threads may still be recording into the old one
+        FlightRecorder *old = m_recorder.fetchAndStoreOrdered(recorder);
+        if(old)
+            m_retiredRecorders.append(old);
+    }
+    updateEnabledThreshold();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_recorder_size", records);
+}
+
+int Logger::flightRecorderSize() const
+{
+    FlightRecorder *recorder = m_recorder;
+    return recorder ? recorder->capacity() : 0;
+}
+
+void Logger::dumpFlightRecorder()
+{
+    FlightRecorder *recorder = m_recorder;
+    if(!recorder)
+        return;
+
+    QList<LogRecord> records = recorder->take();
+    if(records.isEmpty())
+        return;
+
+    // what this thread has staged or queued comes before its context
+    if(config()->bufferSize)
+        LogBuffer::flushAll(this);
+    LogWriter *writer = m_writer;
+    if(writer)
+        writer->flush();
+
+    QMutexLocker locker(&m_operationalMutex);
+    writeUnfiltered(LogRecord(INFO, QString("Flight recorder: the last %1 messages below the threshold follow.")
+                                    .arg(records.size()), 0));
+    foreach(const LogRecord &record, records)
+        writeUnfiltered(record);
+    writeUnfiltered(LogRecord(INFO, "Flight recorder: end.", 0));
+    flushOutput();
+}
+
+void Logger::setCrashHandler(bool enabled)
+{
+    if(enabled)
+        CrashHandler::install();
+    else
+        CrashHandler::uninstall();
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_crash_handler", enabled);
+}
+
+bool Logger::crashHandler() const
+{
+    return CrashHandler::isInstalled();
+}
+
+void Logger::setWatchSettings(bool enabled)
+{
+    if(enabled && !m_watcher) {
+        QSettings s;
+        m_watcher = new ConfigWatcher(this, s.fileName(), SETTINGS_CHECK_INTERVAL);
+        m_watcher->start();
+    }
+    else if(!enabled && m_watcher) {
+        delete m_watcher;
+        m_watcher = 0;
+    }
+
+    // store the setting
+    QSettings s;
+    s.setValue("Log/log_watch_settings", enabled);
+}
+
+bool Logger::watchSettings() const
+{
+    return m_watcher != 0;
+}
+
+void Logger::reloadSettings()
+{
+    // pick up what other processes wrote
+    QSettings settings;
+    settings.sync();
+
+    {
+        QMutexLocker locker(&m_configMutex);
+        LogConfig *config = copyConfig();
+        readConfig(settings, *config);
+        publishConfig(config);
+        updateFlusher();
+    }
+
+    readThresholds(settings);
+    updateEnabledThreshold();
+
+    // only move the log file if it has moved, as opening it truncates it
+    QString path;
+    QString filename;
+    readLogPath(settings, path, filename);
+    if(QFileInfo(path + QDir::separator() + filename) != QFileInfo(logFile.fileName()))
+        openLogPath(path, filename);
+}
+
+const LogConfig *Logger::config() const
+{
+    return m_config;
+}
+
+LogConfig *Logger::copyConfig() const
+{
+    return new LogConfig(*config());
+}
+
+void Logger::publishConfig(LogConfig *config)
+{
+    // logging threads may still be reading the old one
+    LogConfig *old = m_config.fetchAndStoreOrdered(config);
+    if(old)
+        m_retiredConfigs.append(old);
+}
+
+void Logger::readConfig(QSettings &settings, LogConfig &config)
+{
+    // do not rotate the logfile by default
+    config.logMaxSize = settings.value("Log/log_max_size", 0).toLongLong();
+    config.logGenerations = settings.value("Log/log_generations", DEFAULT_GENERATIONS).toInt();
+    // do not buffer by default
+    config.bufferSize = settings.value("Log/log_buffer_size", 0).toInt();
+    config.flushInterval = settings.value("Log/log_flush_interval", DEFAULT_FLUSH_INTERVAL).toInt();
+    // write every repeated message by default
+    config.repeatInterval = settings.value("Log/log_repeat_interval", 0).toInt();
+    // write no statistics by default
+    config.statsInterval = settings.value("Log/log_stats_interval", 0).toInt();
+    // default time format is the time of day, in local time
+    QString timeFormat = settings.value("Log/log_time_format", "TIME").toString();
+    if(timeFormat == "ISO_MS")
+        config.timeFormat = ISO_MILLISECONDS;
+    else if(timeFormat == "ISO_US")
+        config.timeFormat = ISO_MICROSECONDS;
+    else if(timeFormat == "EPOCH_NS")
+        config.timeFormat = EPOCH_NANOSECONDS;
+    else
+        config.timeFormat = TIME_OF_DAY;
+    config.timeUtc = settings.value("Log/log_time_utc", false).toBool();
+    // wait for the writer when the queue is full by default
+    QString overflow = settings.value("Log/log_overflow", overflowNames[OVERFLOW_BLOCK]).toString();
+    config.overflowPolicy = OVERFLOW_BLOCK;
+    for(int i = OVERFLOW_BLOCK; i <= OVERFLOW_DROP_BELOW_WARNING; i++) {
+        if(overflow == overflowNames[i])
+            config.overflowPolicy = OverflowPolicy(i);
+    }
+}
+
+void Logger::readLogPath(QSettings &settings, QString &path, QString &filename)
+{
+    // by default the path is a dot-folder under the users home directory.
+    path = settings.value("Log/log_path", QVariant(QString("%1%2.%3").arg(QDir::homePath(), QDir::separator(), QCoreApplication::applicationName()))).toString();
+    // default filename is <application name>.log
+    filename = settings.value("Log/log_filename", QVariant(QString("%1.log").arg(QCoreApplication::applicationName()))).toString();
+}
+
+void Logger::readThresholds(QSettings &settings)
+{
+    // default threshold is WARNING
+    m_logThreshold = levelFromName(settings.value("Log/log_threshold", "WARNING").toString(), NONE);
+
+    // categories follow the log threshold unless they have one of their own
+    settings.beginGroup("Log/log_category");
+    QStringList names = settings.childKeys();
+    foreach(const QString &name, names) {
+        int level = levelFromName(settings.value(name).toString(), -1);
+        if(level >= 0)
+            LogCategory::setThreshold(name, (LogLevel)level);
+    }
+    settings.endGroup();
+
+    // and those no longer in the settings go back to following it
+    foreach(const QString &name, LogCategory::names()) {
+        if(!names.contains(name))
+            LogCategory::clearThreshold(name);
+    }
+}
+
+void Logger::flush()
+{
+    LogCollapser::flushAll(this);
+    LogBuffer::flushAll(this);
+    LogWriter *writer = m_writer;
+    if(writer)
+        writer->flush();
+}
+
+void Logger::logMessageHandler(QtMsgType type, const char *msg)
+{
+    LogLevel level;
+    switch(type)
+    {
+    case QtDebugMsg:
+        level = DEBUG;
+        break;
+    case QtWarningMsg:
+        level = WARNING;
+        break;
+    case QtCriticalMsg:
+    case QtFatalMsg:
+    default:
+        level = CRITICAL;
+        break;
+    }
+
+    // filtered messages skip both the conversion and the instance lookup.
+    if(type != QtFatalMsg && !isEnabled(level))
+        return;
+
+    Logger *logger = acquire();
+    logger->log(level, QString(msg));
+    // make sure everything is written before the application dies
+    if(type == QtFatalMsg)
+        logger->flush();
+    release();
+
+    if(type == QtFatalMsg) {
+        // Fatal error, kill the application
+        QCoreApplication::quit();
+    }
+}
+
+Logger::Logger() throw()
+{
+    // open file(s) for logging, set logging threshold
+    QSettings settings;
+    QString path;
+    QString filename;
+    // log to console, and do not limit the logfile, by default
+    LogConfig *config = new LogConfig();
+    readConfig(settings, *config);
+    // do not use a ring file by default
+    config->logRingSize = settings.value("Log/log_ring_size", 0).toLongLong();
+    // write through the QFile by default
+    config->logMapped = settings.value("Log/log_mapped", false).toBool();
+    // default format is text
+    QString logFormat = settings.value("Log/log_format", "TEXT").toString();
+    config->logFormat = logFormat == "BINARY" ? BINARY_FORMAT : logFormat == "JSON" ? JSON_FORMAT : TEXT_FORMAT;
+    m_config = config;
+    m_linesLogged = 0;
+    m_logThreshold = NONE;
+    m_enabledThreshold = NONE;
+    // no sinks until they are added
+    m_sinkCount = 0;
+    m_sinkThreshold = NONE;
+    m_recorder = 0;
+    m_rotations = 0;
+    m_rotationDelay = 0;
+    m_ring = 0;
+    m_mapped = 0;
+    m_fileFormat = config->logFormat;
+    // rotated files are compressed one at a time, in order
+    m_rotationPool = new QThreadPool();
+    m_rotationPool->setMaxThreadCount(1);
+    // the colour of the console is decided once
+    m_consoleWriter = new ConsoleWriter();
+    // count from here on
+    m_metrics = new MetricsCollector();
+    // log from the calling thread by default
+    m_writer = 0;
+    m_queueSize = settings.value("Log/log_queue_size", DEFAULT_QUEUE_SIZE).toInt();
+    readLogPath(settings, path, filename);
+    // log scopes rather than profiling them by default
+    Debug::Profiler::setEnabled(settings.value("Log/log_profile", false).toBool());
+    // log every call of LOG_FUNCTION by default
+    Debug::Sampler::setDefaults(settings.value("Log/log_sample_every", 0).toInt(),
+                                settings.value("Log/log_sample_rate", 0).toInt());
+    // do not trace scopes by default
+    m_logTrace = settings.value("Log/log_trace").toString();
+    if(!m_logTrace.isEmpty() && !Debug::Tracer::start(m_logTrace))
+        m_logTrace.clear();
+
+    setLogPath(path, filename);
+
+    // set log threshold, and those of the categories
+    readThresholds(settings);
+    // keep no flight recorder by default
+    int recorderSize = settings.value("Log/log_recorder_size", 0).toInt();
+    if(recorderSize > 0)
+        m_recorder = new FlightRecorder(recorderSize);
+    updateEnabledThreshold();
+
+    // save the staged output on a crash, if asked to
+    if(settings.value("Log/log_crash_handler", false).toBool())
+        CrashHandler::install();
+
+    // start the writer thread if we log asynchronously
+    if(settings.value("Log/log_async", false).toBool()) {
+        LogWriter *writer = new LogWriter(this, m_queueSize);
+        writer->start();
+        m_writer = writer;
+    }
+
+    // write out idle buffers and held back repeats, once there are any
+    m_flusher = 0;
+    {
+        QMutexLocker locker(&m_configMutex);
+        updateFlusher();
+    }
+
+    // pick up changes to the settings while running, if asked to
+    m_watcher = 0;
+    if(settings.value("Log/log_watch_settings", false).toBool())
+        setWatchSettings(true);
+
+    // Setup the qMsgHandler
+    oldHandler = qInstallMsgHandler(Logger::logMessageHandler);
+}
+
+Logger::~Logger() throw()
+{
+    // no more reloading while we take things down
+    delete m_watcher;
+    m_watcher = 0;
+    delete m_flusher;
+    m_flusher = 0;
+
+    // report the repeats still held back
+    LogCollapser::flushAll(this);
+
+    // finish the trace
+    if(!m_logTrace.isEmpty())
+        Debug::Tracer::stop();
+
+    qInstallMsgHandler(oldHandler);
+    CrashHandler::uninstall();
+
+    // write out anything still queued before closing the file
+    LogWriter *writer = m_writer.fetchAndStoreOrdered(0);
+    if(writer) {
+        writer->stop();
+        delete writer;
+    }
+    qDeleteAll(m_retiredWriters);
+    m_retiredWriters.clear();
+
+    // and anything still staged by other threads
+    LogBuffer::flushAll(this);
+
+    // write the profile last, whatever the threshold
+    if(Debug::Profiler::isEnabled()) {
+        QString report = Debug::Profiler::formatReport();
+        if(!report.isEmpty()) {
+            LogRecord record(INFO, "Profile:\n" + report, 0);
+            QMutexLocker locker(&m_operationalMutex);
+            writeUnfiltered(record);
+            flushOutput();
+        }
+        Debug::Profiler::reset();
+    }
+
+    // the sinks outlive the Logger, but are no longer written to.
+    {
+        QMutexLocker locker(&m_operationalMutex);
+        foreach(LogSink *sink, m_sinks)
+            sink->m_logger = 0;
+        m_sinks.clear();
+        m_sinkCount = 0;
+    }
+
+    // nobody records any more, the handler and close() have seen to that.
+    delete m_recorder.fetchAndStoreOrdered(0);
+    qDeleteAll(m_retiredRecorders);
+    m_retiredRecorders.clear();
+
+    // nor does anybody read the settings
+    delete m_config.fetchAndStoreOrdered(0);
+    qDeleteAll(m_retiredConfigs);
+    m_retiredConfigs.clear();
+
+    closeLogFile();
+    delete m_consoleWriter;
+    m_consoleWriter = 0;
+    delete m_metrics;
+    m_metrics = 0;
+
+    // finish compressing rotated files
+    m_rotationPool->waitForDone();
+    delete m_rotationPool;
+
+    // let the next message through to instance(), so a new Logger is created.
+    m_enabledThreshold = DEBUG;
+    LogCategory::setDefaults(DEBUG, NONE);
 }
 
@@ -26,6 +26,11 @@
 #ifndef LOGGER_H
 #define LOGGER_H
 
+#include <cstdarg>
+
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QList>
 #include <QMutex>
 #include <QString>
 #include <QFile>
@@ -34,6 +39,23 @@
 
 #include "export.h"
 
+class ConfigWatcher;
+class ConsoleWriter;
+class FlightRecorder;
+class LogCategory;
+class LogFields;
+class LogFlusher;
+struct LogMetrics;
+class LogSink;
+class LogWriter;
+struct LogRecord;
+struct LogConfig;
+class MappedFile;
+class MetricsCollector;
+class RingFile;
+class QSettings;
+class QThreadPool;
+
 /**
   A simple hierarchy of levels used when logging.
   */
@@ -45,6 +67,106 @@ enum LogLevel {
     NONE,
 };
 
+/**
+  The formats the log file can be written in.
+  */
+enum LogFormat {
+    TEXT_FORMAT,
+    BINARY_FORMAT,
+    /// JSON Lines: a JSON object per message. See jsonformat.h.
+    JSON_FORMAT
+};
+
+/**
+  The ways the time of a message can be printed in the text format.
+  */
+enum TimeFormat {
+    /// the time of day, e.g. 21:04:01.
+    TIME_OF_DAY,
+    /// ISO 8601 date and time with milliseconds, e.g. 2011-06-01T21:04:01.123.
+    ISO_MILLISECONDS,
+    /// ISO 8601 date and time with microseconds, e.g. 2011-06-01T21:04:01.123456.
+    ISO_MICROSECONDS,
+    /// nanoseconds since the epoch, e.g. 1306962241123456789.
+    EPOCH_NANOSECONDS
+};
+
+/**
+  What happens to a message logged asynchronously while the queue is full.
+  */
+enum OverflowPolicy {
+    /// the caller waits for the writer to make room.
+    OVERFLOW_BLOCK,
+    /// the message is dropped.
+    OVERFLOW_DROP_NEWEST,
+    /// the oldest queued message is dropped to make room.
+    OVERFLOW_DROP_OLDEST,
+    /// DEBUG and INFO messages are dropped, others wait for room.
+    OVERFLOW_DROP_BELOW_WARNING
+};
+
+/**
+  The numeric values of the LogLevel enum, for use in preprocessor conditionals.
+  */
+#define LOG_LEVEL_DEBUG    0
+#define LOG_LEVEL_INFO     1
+#define LOG_LEVEL_WARNING  2
+#define LOG_LEVEL_CRITICAL 3
+#define LOG_LEVEL_NONE     4
+
+/**
+  The lowest level compiled into the binary. Log macros below this level
+  expand to nothing. It can be set with -DLOG_MIN_LEVEL=LOG_LEVEL_INFO et cetera,
+  and defaults to leaving out DEBUG when QT_NO_DEBUG_OUTPUT is defined.
+  */
+#ifndef LOG_MIN_LEVEL
+#   if defined QT_NO_DEBUG_OUTPUT
+#       define LOG_MIN_LEVEL LOG_LEVEL_INFO
+#   else
+#       define LOG_MIN_LEVEL LOG_LEVEL_DEBUG
+#   endif
+#endif
+
+/**
+  Logs a printf-style message at the given level, provided the level is enabled.
+  The arguments are not evaluated at all if the level is below the log threshold,
+  so this costs a single load and a branch for disabled levels.
+  */
+#define LOG_AT(level, ...) \
+    do { \
+        if(Logger::isEnabled(level)) \
+            Logger::logAt(level, __VA_ARGS__); \
+    } while(0)
+
+/**
+  Handy macros for logging printf-style messages at a given level, e.g.
+  LOG_DEBUG("Parsed %d descriptions", count).
+  @see LOG_AT
+  */
+#if LOG_MIN_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LOG_AT(DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(...) LOG_AT(INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING(...) LOG_AT(WARNING, __VA_ARGS__)
+#else
+#define LOG_WARNING(...) do { } while(0)
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_LEVEL_CRITICAL
+#define LOG_CRITICAL(...) LOG_AT(CRITICAL, __VA_ARGS__)
+#else
+#define LOG_CRITICAL(...) do { } while(0)
+#endif
+
 /**
   A simple logging singleton. For an explanation on the singleton pattern, see wikipedia
   or "Design Patterns - Elements of Reusable Object-Oriented Software" by Eirch Gamma et al.
@@ -61,12 +183,16 @@ public:
     /**
       Returns an instance of the LogSingleton.
       This uses lazy initialisation, so the specific instance is not created
-      until the first time someone calls instance().
+      until the first time someone calls instance(). Once the instance
+      exists, this does not lock.
       @return a pointer to the LogSingleton instance.
       */
     static Logger* instance() throw();
     /**
       Deletes the instance created by instance().
+      Messages passing through the Qt message handler or the LOG_ macros
+      at the same time are waited for, but the caller must make sure no
+      other thread is using a pointer it got from instance() directly.
       @note that if instance() is called after close(), a new instance
       will be created.
       */
@@ -83,6 +209,84 @@ public:
       @see setConsoleLogging()
       */
     void log(LogLevel level, QString message) throw();
+    /**
+      Prints a printf-style log message to the logfile.
+      Behaves like log().
+      In the binary format with console logging disabled, the message is
+      never formatted: only a reference to the format string and the raw
+      arguments are written.
+      @param level the priority of the log message.
+      @param format the printf-style format of the message. This must
+      outlive the Logger, as a string literal does, since the binary
+      format refers to it by address.
+      */
+    void logf(LogLevel level, const char *format, ...) throw();
+
+    /**
+      Logs a message in a category, provided the level is enabled for it.
+      The message is prefixed with the name of the category.
+      @param category the category of the message.
+      @param level the priority of the message.
+      @param message the message to log.
+      @see LogCategory
+      */
+    void log(const LogCategory &category, LogLevel level, QString message) throw();
+
+    /**
+      Logs a printf-style message in a category, provided the level is
+      enabled for it. Messages in a category are always formatted, so that
+      the name of the category can be prefixed.
+      @param category the category of the message.
+      @param level the priority of the message.
+      @param format the printf-style format string.
+      */
+    void logf(const LogCategory &category, LogLevel level, const char *format, ...) throw();
+
+    /**
+      Logs a message with structured key/value fields. This is what the
+      LOG_FIELDS macro uses. The fields are serialised when they are added,
+      and are written as members of the message's object in the JSON format,
+      or after the message otherwise.
+      @param level the priority of the message.
+      @param message the message, as UTF-8.
+      @param fields the fields of the message.
+      @see LogFields
+      */
+    void log(LogLevel level, const char *message, const LogFields &fields) throw();
+
+    /**
+      Logs a printf-style message like logf(), through an instance which
+      close() waits for, like the Qt message handler. This is what the
+      LOG_DEBUG, LOG_INFO, LOG_WARNING and LOG_CRITICAL macros use, so
+      they are safe against another thread closing the Logger.
+      @see logf()
+      */
+    static void logAt(LogLevel level, const char *format, ...) throw();
+    /**
+      Logs a printf-style message in a category like logf(), through an
+      instance which close() waits for. This is what LOG_CATEGORY_AT uses.
+      */
+    static void logAt(const LogCategory &category, LogLevel level, const char *format, ...) throw();
+    /**
+      Logs a message with fields like log(), through an instance which
+      close() waits for. This is what LOG_FIELDS uses.
+      */
+    static void logFieldsAt(LogLevel level, const char *message, const LogFields &fields) throw();
+
+    /**
+      Will a message of the given level be logged?
+      A message is logged if the log file or any of the sinks wants it.
+      This is a single relaxed load of the lowest of their thresholds, and
+      does not need an instance of the Logger. Before the Logger has been created,
+      all levels are reported as enabled so that the first message gets
+      through to instance().
+      @param level the priority of the message.
+      @returns true if the message would be logged, false if not.
+      */
+    static bool isEnabled(LogLevel level)
+    {
+        return level >= m_enabledThreshold;
+    }
 
     /**
       Sets and stores the path and filename of the log file.
@@ -120,15 +324,39 @@ public:
 
     /**
       Sets and stores the log threshold the logger will use to determine
-      if it should log a given message.
+      if it should log a given message to the log file and the console.
       A log threshold of DEBUG will log everything, while a threshold of
       NONE will (surprisingly enough) log nothing.
+      Sinks have thresholds of their own.
       @see LogLevel
+      @see LogSink::setThreshold()
       @param level the log threshold to use when logging.
       @note this function will store the log threshold using QSettings, so
       the setting will be saved for later runs of the program.
       */
     void setLogThreshold(LogLevel level);
+    /**
+      Sets and stores the threshold of a category, which its messages are
+      filtered by instead of the log threshold.
+      @param name the name of the category.
+      @param level the threshold to use for the category.
+      @note this function will store the threshold using QSettings, so
+      the setting will be saved for later runs of the program.
+      @see LogCategory
+      */
+    void setCategoryThreshold(const QString &name, LogLevel level);
+    /**
+      Lets a category follow the log threshold again, and removes its
+      threshold from the settings.
+      @param name the name of the category.
+      */
+    void clearCategoryThreshold(const QString &name);
+    /**
+      Returns the threshold of a category, which is the log threshold
+      unless one has been set for the category.
+      @param name the name of the category.
+      */
+    LogLevel categoryThreshold(const QString &name) const;
     /**
       Returns the log threshold the logger currently uses.
       The log threshold is the filter that defines how much the logger
@@ -140,6 +368,62 @@ public:
       */
     LogLevel logThreshold() const;
 
+    /**
+      Sets and stores the format of the log file.
+      The text format is the human readable format written by default.
+      The binary format writes each record with a raw timestamp, the level,
+      thread and indentation, and for messages logged through logf() or the
+      LOG_* macros, a reference to the format string and the raw arguments.
+      Formatting is then left to the logdecode tool, which makes logging
+      considerably cheaper and the log file considerably smaller.
+      The JSON format writes each message as a line holding a JSON object,
+      for log shippers and other tools to parse.
+      Changing the format truncates the log file.
+      @param format the format to write the log file in.
+      @note this function will store the format using QSettings, so the
+      setting will be saved for later runs of the program.
+      @note messages are still formatted as text for the console. Disable
+      logging to console to get the full benefit of the binary format.
+      */
+    void setLogFormat(LogFormat format);
+    /**
+      Returns the format of the log file.
+      @see setLogFormat()
+      */
+    LogFormat logFormat() const;
+
+    /**
+      Sets how the time of each message is printed in the text format.
+      The default is the time of day, which only has second resolution.
+      The ISO 8601 formats add the date and the milliseconds or microseconds,
+      and EPOCH_NANOSECONDS prints the raw time, which is the cheapest to
+      write and to sort by. The binary format always stores the raw time.
+      @param format how to print the time.
+      @note this function will store the format using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setLogTimeFormat(TimeFormat format);
+    /**
+      Returns how the time of each message is printed.
+      @see setLogTimeFormat()
+      */
+    TimeFormat logTimeFormat() const;
+
+    /**
+      Shall times be printed in UTC rather than local time?
+      ISO 8601 times printed in UTC are suffixed with a Z.
+      This is disabled by default.
+      @param enabled true to print times in UTC.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setLogTimeUtc(bool enabled);
+    /**
+      Are times printed in UTC?
+      @see setLogTimeUtc()
+      */
+    bool logTimeUtc() const;
+
     /**
       Shall we print log messages to the console as well as the file?
       This allows you to disable console logging which is useful in the case of background
@@ -174,6 +458,397 @@ public:
       */
     int logLimit() const;
 
+    /**
+      Shall we rotate the logfile when it reaches a certain size?
+      When a message would take the log file past this size, the file is
+      renamed out of the way and a new one is started. In the background,
+      the old file is then compressed into app.log.1.gz, after moving
+      app.log.1.gz to app.log.2.gz and so on, keeping the number of
+      generations given by setLogGenerations().
+      Setting this to zero disables rotation, which is the default.
+      @param numBytes the maximum size of the log file.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see setLogGenerations()
+      */
+    void setLogMaxSize(qint64 numBytes);
+    /**
+      Returns the size at which the logfile is rotated, or zero if it is not.
+      @see setLogMaxSize()
+      */
+    qint64 logMaxSize() const;
+    /**
+      Sets the number of compressed generations kept when rotating the logfile.
+      The default is 5.
+      @param generations the number of old log files to keep.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see setLogMaxSize()
+      */
+    void setLogGenerations(int generations);
+    /**
+      Returns the number of compressed generations kept when rotating the logfile.
+      @see setLogGenerations()
+      */
+    int logGenerations() const;
+
+    /**
+      Shall the logfile be a fixed-size ring?
+      This is useful on embedded platforms with limited storage, as an
+      alternative to setLogLimit(). The log file is allocated once at the
+      given size, plus a small header, and written as a circular buffer:
+      it always holds the newest output and never grows, shrinks or gets
+      renamed. An existing ring is continued rather than truncated when
+      the Logger starts, so the output leading up to a reset survives it.
+      Use logdecode, or RingFile::unwrap(), to read the output back in order.
+      The log limit and rotation are not used for a ring, and it is always
+      written in the text format.
+      Setting this to zero disables the ring, which is the default.
+      Changing the size starts the log file over.
+      @param numBytes the number of bytes of output to keep.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setLogRingSize(qint64 numBytes);
+    /**
+      Returns the size of the ring the logfile is written as, or zero if
+      it is written as an ordinary file.
+      @see setLogRingSize()
+      */
+    qint64 logRingSize() const;
+
+    /**
+      Shall the logfile be written through a memory mapping?
+      This is meant for the highest logging rates. The log file is extended
+      and mapped a few megabytes at a time, and writing a message becomes a
+      copy into the mapping rather than a system call. The file is trimmed
+      to the output actually written when it is closed; until then, and
+      after a crash, it ends in zeros. A ring file is never mapped.
+      This is disabled by default. Changing it starts the log file over.
+      @param enabled set to true to write through a mapping, false to write
+      through the file.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setLogMapped(bool enabled);
+    /**
+      Is the logfile written through a memory mapping?
+      @see setLogMapped()
+      */
+    bool logMapped() const;
+
+    /**
+      Shall Debug::Scope, and so LOG_FUNCTION, be profiled rather than logged?
+      When enabled, scopes write no lines. Debug::Profiler collects the
+      number of calls and the time spent in each instead, and the report is
+      written to the log when the Logger is closed, whatever the threshold.
+      This is disabled by default.
+      @param enabled true to profile scopes.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see Debug::Profiler
+      */
+    void setLogProfile(bool enabled);
+    /**
+      Are scopes profiled rather than logged?
+      @see setLogProfile()
+      */
+    bool logProfile() const;
+
+    /**
+      Shall Debug::Scope, and so LOG_FUNCTION, be traced to a file?
+      The trace is written in the Chrome trace event format, to be opened
+      with chrome://tracing or Perfetto, and finished when the Logger is
+      closed. Tracing comes in addition to the log lines of the scopes.
+      Raise the threshold above DEBUG, or enable profiling, to only trace.
+      @param path the file to write the trace to, or an empty string to
+      stop tracing, which is the default.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see Debug::Tracer
+      */
+    void setLogTrace(const QString &path);
+    /**
+      Returns the file scopes are traced to, or an empty string if they are not.
+      @see setLogTrace()
+      */
+    QString logTrace() const;
+
+    /**
+      Shall LOG_FUNCTION only log one call in this many, for each function?
+      The calls left out are not formatted at all. They are counted, and
+      reported by the next call logged in a new second.
+      The default is zero, logging every call.
+      @param every log one call in this many. Zero or one logs every call.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see Debug::Sampler, LOG_FUNCTION_SAMPLED
+      */
+    void setLogSampleEvery(int every);
+    /**
+      Returns the one in how many calls LOG_FUNCTION logs.
+      @see setLogSampleEvery()
+      */
+    int logSampleEvery() const;
+
+    /**
+      Shall LOG_FUNCTION log at most this many calls a second, for each function?
+      The calls left out are counted and reported as with setLogSampleEvery().
+      The default is zero, meaning no limit.
+      @param perSecond the largest number of calls logged a second.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see Debug::Sampler, LOG_FUNCTION_SAMPLED
+      */
+    void setLogSampleRate(int perSecond);
+    /**
+      Returns how many calls a second LOG_FUNCTION logs at most.
+      @see setLogSampleRate()
+      */
+    int logSampleRate() const;
+
+    /**
+      Shall we write log messages from a background thread?
+      In asynchronous mode, log() only places the message on a bounded queue,
+      and a writer thread owned by the Logger writes it to the file and the
+      console. This keeps disk and terminal I/O off the calling thread.
+      If the queue is full, what happens depends on the overflow policy;
+      by default log() will wait for the writer to catch up.
+      Threads logging while asynchronous mode is disabled are safe: a
+      message reaching the stopped writer is written by the caller.
+      Any messages still queued are written when asynchronous mode is
+      disabled or the Logger is closed.
+      This is disabled by default.
+      @param enabled set to true to log asynchronously, false to log from
+      the calling thread.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setAsynchronous(bool enabled);
+    /**
+      Does the Logger write log messages from a background thread?
+      @returns true if logging is asynchronous, false if it is not.
+      @see setAsynchronous()
+      */
+    bool asynchronous() const;
+
+    /**
+      Sets and stores what happens to a message logged asynchronously
+      while the queue is full. Blocking keeps every message, but a slow
+      disk then stalls every thread that logs. The other policies keep
+      the callers going by dropping messages, and count what they drop.
+      Once the writer has caught up, a WARNING saying how many messages
+      of each level were dropped is written in their place.
+      The default is OVERFLOW_BLOCK.
+      @param policy the policy to apply.
+      @note this function will store the policy using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see droppedMessages()
+      */
+    void setOverflowPolicy(OverflowPolicy policy);
+    /**
+      Returns what happens to a message logged while the queue is full.
+      @see setOverflowPolicy()
+      */
+    OverflowPolicy overflowPolicy() const;
+    /**
+      Returns how many messages of a level have been dropped because the
+      queue was full, since the Logger was created.
+      @param level the level of the messages.
+      */
+    qint64 droppedMessages(LogLevel level) const;
+
+    /**
+      Returns what the Logger itself has done and what it has cost since
+      it was created: the messages accepted, filtered and dropped, the bytes
+      written, how long writes and flushes took, how often and how long
+      threads waited for each other, the truncations and the queue depth.
+      Messages are counted per thread and merged here, so counting them
+      costs no locking.
+      @see LogMetrics
+      */
+    LogMetrics metrics() const;
+
+    /**
+      Sets and stores how often a line of statistics is written to the log,
+      whatever the threshold. The line is written along with other output,
+      so nothing is written while nothing is logged.
+      This is disabled by default.
+      @param msecs the interval in ms, or 0 to write no statistics.
+      @note this function will store the interval using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see metrics()
+      */
+    void setStatisticsInterval(int msecs);
+    /**
+      Returns how often a line of statistics is written, in ms.
+      @see setStatisticsInterval()
+      */
+    int statisticsInterval() const;
+
+    /**
+      Shall we stage log output in per-thread buffers?
+      When buffering, each thread formats its messages into a buffer of its
+      own, and the buffer is written to the log file in one go once it holds
+      at least the given number of bytes, or once it has held data for longer
+      than the flush interval. Messages from a single thread stay in order,
+      but messages from different threads are only ordered between flushes.
+      Buffers are also flushed by flush() and when the Logger is closed.
+      Buffering is not used in asynchronous mode, where the writer thread
+      already writes in batches.
+      Setting this to zero disables buffering, which is the default.
+      @param numBytes the size a buffer may reach before it is flushed.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @note the log limit is applied per flush when buffering.
+      @see setFlushInterval()
+      */
+    void setBufferSize(int numBytes);
+    /**
+      Returns the size a per-thread buffer may reach before it is flushed.
+      If this value is zero, output is not buffered.
+      @see setBufferSize()
+      */
+    int bufferSize() const;
+    /**
+      Sets the longest time a per-thread buffer may hold data before
+      it is flushed. The interval is checked whenever the owning thread logs.
+      The default is 1000 ms.
+      @param msecs the flush interval in milliseconds.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see setBufferSize()
+      */
+    void setFlushInterval(int msecs);
+    /**
+      Returns the longest time a per-thread buffer may hold data.
+      @see setFlushInterval()
+      */
+    int flushInterval() const;
+    /**
+      Collapses repeated messages. When a thread logs the same message at
+      the same level several times in a row, only the first one is written,
+      and the repeats are counted. A single "Last message repeated N times."
+      line is written in their place once the thread logs a different
+      message, or once the repeats have been held back for the given
+      interval. The interval is checked whenever the thread logs; held back
+      repeats are also reported by flush() and when the Logger is closed.
+      Messages are compared per thread, so repeats are not collapsed across
+      threads. Setting this to zero writes every message, which is the default.
+      @param msecs the longest time repeats are held back, in milliseconds.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      */
+    void setRepeatInterval(int msecs);
+    /**
+      Returns the longest time repeated messages are held back.
+      If this value is zero, repeated messages are not collapsed.
+      @see setRepeatInterval()
+      */
+    int repeatInterval() const;
+    /**
+      Registers a sink, which messages are written to from now on in
+      addition to the log file and the console. The sink is not owned by
+      the Logger, and must be removed before it is deleted. Sinks are
+      removed when the Logger is closed.
+      @param sink the sink to add.
+      @see LogSink
+      */
+    void addSink(LogSink *sink);
+    /**
+      Removes a sink added by addSink(). Once this returns, no more
+      messages are written to the sink.
+      @param sink the sink to remove.
+      */
+    void removeSink(LogSink *sink);
+    /**
+      Returns the sinks added by addSink().
+      */
+    QList<LogSink *> sinks() const;
+    /**
+      Keeps the newest messages below the log threshold in memory, in a ring
+      holding the given number of messages. When a CRITICAL message is
+      logged, which includes a fatal message reaching the Qt message handler,
+      the ring is written to the log file before it, so the full context of
+      the problem is logged without writing every DEBUG message to disk.
+      Recording takes no lock, but it does mean that messages below the
+      threshold are captured rather than filtered straight away.
+      Setting this to zero disables the flight recorder, which is the default.
+      @param records the number of messages kept.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see dumpFlightRecorder()
+      */
+    void setFlightRecorderSize(int records);
+    /**
+      Returns the number of messages kept by the flight recorder.
+      If this value is zero, the flight recorder is disabled.
+      @see setFlightRecorderSize()
+      */
+    int flightRecorderSize() const;
+    /**
+      Writes the messages kept by the flight recorder to the log file and
+      the console, whatever the threshold, and empties the recorder.
+      @see setFlightRecorderSize()
+      */
+    void dumpFlightRecorder();
+    /**
+      Watches the settings for changes made while the application runs,
+      e.g. by editing the settings file, and applies them within a second.
+      This covers the log threshold and those of the categories, the path
+      and the filename of the log file, the limits on its size, the time
+      format, buffering and the collapsing of repeated messages. Other
+      settings are only read when the Logger is created.
+      The settings file is checked by a thread of its own, so this works
+      without an event loop. The settings are not watched by default.
+      @param enabled true to watch the settings, false to stop.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @note only settings kept in a file can be watched, which excludes
+      the registry on Windows.
+      @see reloadSettings()
+      */
+    void setWatchSettings(bool enabled);
+    /**
+      Are the settings watched for changes?
+      @see setWatchSettings()
+      */
+    bool watchSettings() const;
+    /**
+      Applies the settings as they are now, as setWatchSettings() does
+      when the settings file has changed.
+      Logging threads are never blocked by this: the settings they read are
+      published as a whole, through an atomic pointer.
+      */
+    void reloadSettings();
+    /**
+      Installs a handler for the signals a crashing process receives, which
+      writes the output still staged in the per-thread buffers to the log file
+      before the process dies. The handler only makes async-signal-safe calls,
+      so it can only write output which is already formatted: records still
+      queued in asynchronous mode are lost, and ring files and mapped files
+      are left alone. The handler is only available on Unix, and is not
+      installed by default.
+      @param enabled true to install the handler, false to remove it.
+      @note this function will store the setting using QSettings, so the
+      setting will be saved for later runs of the program.
+      @see setBufferSize()
+      */
+    void setCrashHandler(bool enabled);
+    /**
+      Is the crash handler installed?
+      @see setCrashHandler()
+      */
+    bool crashHandler() const;
+    /**
+      Writes out any buffered output of all threads, reports any repeated
+      messages still held back, and waits for the records queued in
+      asynchronous mode to be written.
+      @see setBufferSize()
+      @see setRepeatInterval()
+      */
+    void flush();
+
 protected:
     /**
       Default constructor.
@@ -193,28 +868,354 @@ protected:
     static void logMessageHandler(QtMsgType type, const char *msg);
 
 private:
+    /**
+      Returns the instance, creating it if need be, and holds off close()
+      until release() is called.
+      */
+    static Logger *acquire();
+    /**
+      Lets close() go ahead again, once the instance returned by acquire()
+      is no longer used.
+      */
+    static void release();
+    /**
+      Implements logf() with the arguments in a va_list.
+      */
+    void vlogf(LogLevel level, const char *format, va_list ap);
+    /**
+      Implements logf() in a category with the arguments in a va_list.
+      */
+    void vlogf(const LogCategory &category, LogLevel level, const char *format, va_list ap);
+    friend class LogWriter;
+    friend class LogBuffer;
+    friend class LogCollapser;
+    friend class LogFlusher;
+    friend class LogSink;
+
+    /**
+      Returns the current snapshot of the settings read while logging.
+      */
+    const LogConfig *config() const;
+    /**
+      Returns a copy of the current snapshot, to be changed and published.
+      m_configMutex must be held when calling this.
+      */
+    LogConfig *copyConfig() const;
+    /**
+      Publishes a new snapshot of the settings in place of the current one.
+      m_configMutex must be held when calling this.
+      */
+    void publishConfig(LogConfig *config);
+    /**
+      Reads the settings kept in a snapshot.
+      */
+    static void readConfig(QSettings &settings, LogConfig &config);
+    /**
+      Reads the path and the filename of the log file.
+      */
+    static void readLogPath(QSettings &settings, QString &path, QString &filename);
+    /**
+      Reads the log threshold and the thresholds of the categories.
+      */
+    void readThresholds(QSettings &settings);
+    /**
+      Opens the log file at the given path, without storing the path.
+      */
+    void openLogPath(const QString &dir, const QString &filename);
+    /**
+      Logs a message which has passed the threshold of its category,
+      or the log threshold if it has none.
+      */
+    void logMessage(const LogCategory *category, LogLevel level, const QString &message,
+                    const QByteArray &fields = QByteArray());
+    /**
+      Returns the threshold a record is written to the log file and
+      the console with, which is that of its category if it has one.
+      */
+    int fileThreshold(const LogRecord &record) const;
+    /**
+      Keeps a record below the threshold in the flight recorder, or writes
+      out the flight recorder before a critical record.
+      @returns true if the record was only let through for the flight
+      recorder, and need not be dispatched.
+      */
+    bool captureRecord(const LogRecord &record);
+    /**
+      Queues, stages or writes a record, depending on the mode we are in.
+      */
+    void dispatch(const LogRecord &record);
+    /**
+      Recomputes the lowest threshold of the log file and the sinks.
+      */
+    void updateEnabledThreshold();
+    /**
+      Recomputes the lowest threshold of the log file and the sinks.
+      The operational mutex must be held when calling this.
+      */
+    void updateEnabledThresholdLocked();
+    /**
+      Removes a sink, if it is registered.
+      The operational mutex must be held when calling this.
+      @return whether the sink was registered.
+      */
+    bool detachSink(LogSink *sink);
+    /**
+      Writes a record to the log file and the console, whatever the threshold.
+      The operational mutex must be held when calling this.
+      */
+    void writeUnfiltered(const LogRecord &record);
+    /**
+      Writes a record to the sinks which accept it.
+      The operational mutex must be held when calling this.
+      @param record the record to write.
+      @param text the record formatted as text, if it has been already.
+      */
+    void writeSinks(const LogRecord &record, const QByteArray &text);
+    /**
+      Logs that the last message was repeated a number of times.
+      Used by LogCollapser.
+      @param level the level of the repeated message.
+      @param repeats how many times it was repeated.
+      @param thread the thread which repeated it, as the report may be
+      written from another.
+      */
+    void logRepeats(LogLevel level, int repeats, quint64 thread);
+    /**
+      Creates a record for a message of the Logger's own, encoded if the
+      log file is binary. The caller writes it.
+      */
+    LogRecord internalRecord(LogLevel level, const QString &message) const;
+    /**
+      Returns the metrics. The operational mutex must be held when calling this.
+      */
+    LogMetrics currentMetrics() const;
+    /**
+      Returns how many messages of a level the writers have dropped.
+      The operational mutex must be held when calling this.
+      */
+    qint64 countDropped(LogLevel level) const;
+    /**
+      Formats a record into a line of log output, including the newline.
+      */
+    QString format(const LogRecord &record) const;
+    /**
+      Renders a record into the output for the log file and the console.
+      The console output is left empty if we do not log to the console.
+      A record encoded with its raw arguments can only be rendered in
+      another format with the operational mutex held.
+      @param format the format to render the file output in.
+      */
+    void render(const LogRecord &record, LogFormat format, QByteArray &file, QByteArray &console) const;
+    /**
+      Writes a record to the log file and the console.
+      The operational mutex must be held when calling this.
+      */
+    void write(const LogRecord &record);
+    /**
+      Writes a batch of records, taking the operational mutex once.
+      Used by the LogWriter in asynchronous mode.
+      @param records the records to write.
+      @param report a report of dropped messages to write after them,
+      whatever the threshold, or an empty string.
+      */
+    void writeBatch(const QList<LogRecord> &records, const QString &report);
+    /**
+      Writes already formatted output to the log file and the console.
+      The operational mutex must be held when calling this.
+      @param file the output for the log file.
+      @param console the output for the console, which may be empty.
+      @param lines the number of lines in the output.
+      */
+    void writeOutput(const QByteArray &file, const QByteArray &console, int lines);
+    /**
+      Writes the contents of a per-thread staging buffer, taking
+      the operational mutex once. Used by LogBuffer.
+      @param format the format the file output was rendered in. Output
+      which does not fit the log file, as it has been reopened in another
+      format since, is discarded and reported.
+      */
+    void writeStaged(const QByteArray &file, const QByteArray &console, int lines, LogFormat format);
+    /**
+      Writes out the per-thread buffers which have held data for longer
+      than the flush interval, and reports the repeats held back for
+      longer than the repeat interval. Used by LogFlusher.
+      @returns how long to wait before checking again, in ms.
+      */
+    int flushExpired();
+    /**
+      Starts the LogFlusher once there is something for it to flush or report,
+      and has it pick up changed intervals.
+      m_configMutex must be held when calling this.
+      */
+    void updateFlusher();
+    /**
+      Flushes the log file and writes the console output queued so far.
+      The operational mutex must be held when calling this.
+      */
+    void flushOutput();
+    /**
+      (Re)opens the log file in the current format, truncating it.
+      The operational mutex must be held when calling this.
+      @param truncate false to append to the file in the format it was
+      written in so far instead.
+      */
+    void openLogFile(bool truncate = true);
+    /**
+      Closes the log file, trimming it if it is mapped.
+      The operational mutex must be held when calling this.
+      */
+    void closeLogFile();
+    /**
+      Writes raw data to the log file, through the mapping if there is one.
+      Should the mapping fail, it is given up and the data written through
+      the QFile instead. The operational mutex must be held when calling this.
+      */
+    void writeData(const char *data, qint64 length);
+    /**
+      Returns the number of bytes written to the log file.
+      */
+    qint64 logSize() const;
+    /**
+      Returns the format records are rendered in for the log file, by the
+      current snapshot. A ring file is never binary, as a binary log can
+      not survive losing its oldest output.
+      */
+    LogFormat outputFormat() const;
+    /**
+      Are records encoded in the binary format for the log file?
+      */
+    bool writesBinary() const;
+    /**
+      Returns the format string id of a record encoded with its raw
+      arguments, or zero if it holds text.
+      */
+    static quint32 encodedFormatId(const LogRecord &record);
+    /**
+      Returns a record holding the text of a record encoded with its raw
+      arguments, which refer to format definitions only the log file has.
+      The operational mutex must be held when calling this.
+      */
+    LogRecord decodeRecord(const LogRecord &record) const;
+    /**
+      Moves the full log file out of the way, opens a new one and leaves
+      the old one to be compressed by a LogRotator.
+      The operational mutex must be held when calling this.
+      */
+    void rotate();
+    /**
+      Writes the binary file header and the format definitions made so far.
+      The operational mutex must be held when calling this.
+      */
+    void writeFileHeader();
+    /**
+      Returns the binary format id of the given format string,
+      defining it if it has not been seen before.
+      */
+    quint32 formatId(const char *format);
+    /**
+      Gives the format string an id and writes its definition to the log file.
+      */
+    quint32 registerFormat(const char *format);
+
+    /// the default maximum number of records queued in asynchronous mode.
+    static const int DEFAULT_QUEUE_SIZE = 8192;
+    /// the default flush interval of the per-thread buffers, in ms.
+    static const int DEFAULT_FLUSH_INTERVAL = 1000;
+    /// the default number of generations kept when rotating.
+    static const int DEFAULT_GENERATIONS = 5;
+    /// how often the settings file is checked for changes, in ms.
+    static const int SETTINGS_CHECK_INTERVAL = 1000;
+    /// how often the LogFlusher checks when there is nothing to flush, in ms.
+    static const int FLUSH_CHECK_INTERVAL = 1000;
+    /// how often the LogFlusher checks at most, in ms.
+    static const int MIN_FLUSH_CHECK_INTERVAL = 10;
+    /// the number of bytes a mapped log file is extended and mapped by.
+    static const qint64 MAP_CHUNK_SIZE = 4 * 1024 * 1024;
+
     /// for thread safety
     static QMutex m_creationalMutex;
     static QMutex m_operationalMutex;
     /// the file to log to.
     QFile logFile;
     /// the single instance kept of this class.
-    static Logger *_instance;
+    /// Atomic, so instance() can read it without locking once it exists.
+    static QAtomicPointer<Logger> _instance;
+    /// How many calls of logMessageHandler() and the LOG_ macros are using the instance?
+    /// close() waits for these before deleting it.
+    static QAtomicInt m_handlerCalls;
     /// the minimum log threshold read using QSettings.
-    LogLevel m_logThreshold;
+    /// Applies to the log file and the console.
+    static QAtomicInt m_logThreshold;
+    /// the lowest threshold of the log file and the sinks.
+    /// Static and atomic, so isEnabled() can read it without locking.
+    static QAtomicInt m_enabledThreshold;
     /// The previous message handler. Restore this upon destruction.
     QtMsgHandler oldHandler;
-    /// Shall we log to the console as well as the file?
-    bool m_logToConsole;
-    /// How many lines should be logged before we truncate the file?
-    int m_logLimit;
+    /// the format the open log file is written in, which records
+    /// rendered or staged for another are checked against.
+    /// Protected by the operational mutex.
+    LogFormat m_fileFormat;
+    /// the file scopes are traced to, if any.
+    QString m_logTrace;
     /// How many lines have we logged so far?
     int m_linesLogged;
-
-#ifdef Q_OS_LINUX
-    /// Support colours in the terminal.
-    static QString col[4];
-#endif
+    /// How many times have we rotated? Used, along with the process id,
+    /// to give the rotated files unique names.
+    int m_rotations;
+    /// How far the logfile may grow past the maximum size before rotating
+    /// it is tried again, after it failed.
+    qint64 m_rotationDelay;
+    /// Runs the LogRotator jobs, one at a time.
+    QThreadPool *m_rotationPool;
+    /// The ring the logfile is written as, if any.
+    RingFile *m_ring;
+    /// The mapping the logfile is written through, if any.
+    MappedFile *m_mapped;
+    /// The background writer, if we are logging asynchronously.
+    /// Atomic, so log() can load it without locking.
+    QAtomicPointer<LogWriter> m_writer;
+    /// writers which have been stopped while logging threads may still
+    /// hold them, along with their drop counts. Deleted along with the Logger.
+    /// Protected by the operational mutex.
+    QList<LogWriter *> m_retiredWriters;
+    /// serialises starting and stopping the writer.
+    static QMutex m_writerMutex;
+    /// How many records may be queued in asynchronous mode?
+    int m_queueSize;
+    /// the settings read while logging, published as a whole.
+    /// Atomic, so logging threads never wait for a setter or a reload.
+    QAtomicPointer<LogConfig> m_config;
+    /// snapshots replaced while logging threads may still be reading them.
+    /// They are small and rarely replaced, so they are deleted along with
+    /// the Logger. Protected by m_configMutex.
+    QList<LogConfig *> m_retiredConfigs;
+    /// serialises the setters and reloads publishing snapshots.
+    QMutex m_configMutex;
+    /// The thread watching the settings for changes, if any.
+    ConfigWatcher *m_watcher;
+    /// The thread writing out idle per-thread buffers and held back repeats,
+    /// once buffering or collapsing is enabled.
+    /// Protected by m_configMutex.
+    LogFlusher *m_flusher;
+    /// the sinks written to besides the log file and the console.
+    /// Protected by the operational mutex.
+    QList<LogSink *> m_sinks;
+    /// How many sinks are there? Read without locking.
+    QAtomicInt m_sinkCount;
+    /// the lowest threshold of the sinks, NONE if there are none.
+    QAtomicInt m_sinkThreshold;
+    /// the ring of the newest messages below the threshold, if any.
+    /// Atomic, so log() can record without locking.
+    QAtomicPointer<FlightRecorder> m_recorder;
+    /// recorders replaced while messages may still be recorded into them.
+    /// Deleted along with the Logger.
+    QList<FlightRecorder *> m_retiredRecorders;
+    /// writes to the console in batches.
+    /// Only written with the operational mutex held.
+    ConsoleWriter *m_consoleWriter;
+    /// counts what the Logger does.
+    /// Only counted into with the operational mutex held, apart from messages.
+    MetricsCollector *m_metrics;
 };
 
 #endif // LOGSINGLETON_H
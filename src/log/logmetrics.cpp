@@ -0,0 +1,292 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogMetrics and MetricsCollector.
+  */
+#include "logmetrics.h"
+
+#include <QAtomicInt>
+#include <QList>
+#include <QMutexLocker>
+#include <QStringList>
+#include <QThreadStorage>
+
+namespace {
+    /**
+      The messages counted by a single thread.
+      Only the owning thread changes the counts, so it needs no atomic
+      increments, but they are atomic so that mergeCounts() can read them
+      from another thread without tearing. A count is folded into the
+      retired counts long before it could overflow.
+      */
+    struct ThreadCounts
+    {
+        ThreadCounts();
+        ~ThreadCounts();
+
+        QAtomicInt accepted[NONE];
+        QAtomicInt filtered[NONE];
+    };
+
+    /// a thread folds a count into the retired counts once it gets this high.
+    const int FOLD_LIMIT = 1 << 30;
+
+    /// the counts of each thread, deleted when the thread exits.
+    QThreadStorage<ThreadCounts *> localCounts;
+    /// the counts of all live threads, so that they can be merged.
+    QList<ThreadCounts *> registry;
+    /// the counts of the threads which have exited, and those folded in by live ones.
+    qint64 retiredAccepted[NONE];
+    qint64 retiredFiltered[NONE];
+    /// protects the registry and the retired counts.
+    QMutex registryMutex;
+
+    ThreadCounts::ThreadCounts()
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.append(this);
+    }
+
+    ThreadCounts::~ThreadCounts()
+    {
+        QMutexLocker locker(&registryMutex);
+        registry.removeOne(this);
+        for(int i = DEBUG; i < NONE; i++) {
+            retiredAccepted[i] += accepted[i];
+            retiredFiltered[i] += filtered[i];
+        }
+    }
+
+    ThreadCounts *threadCounts()
+    {
+        if(!localCounts.hasLocalData())
+            localCounts.setLocalData(new ThreadCounts());
+        return localCounts.localData();
+    }
+
+    /**
+      Counts a message in the calling thread's counts.
+      @param counts the counts of the calling thread, by level.
+      @param retired the retired counts to fold them into, by level.
+      */
+    void count(QAtomicInt *counts, qint64 *retired, LogLevel level)
+    {
+        // a plain load and store, as no other thread changes the count.
+        int count = counts[level] + 1;
+        if(count < FOLD_LIMIT) {
+            counts[level] = count;
+            return;
+        }
+        QMutexLocker locker(&registryMutex);
+        retired[level] += count;
+        counts[level] = 0;
+    }
+
+    /**
+      Adds up the message counts of all threads.
+      */
+    void mergeCounts(LogMetrics &metrics)
+    {
+        QMutexLocker locker(&registryMutex);
+        for(int i = DEBUG; i < NONE; i++) {
+            metrics.accepted[i] = retiredAccepted[i];
+            metrics.filtered[i] = retiredFiltered[i];
+        }
+        foreach(const ThreadCounts *counts, registry) {
+            for(int i = DEBUG; i < NONE; i++) {
+                metrics.accepted[i] += counts->accepted[i];
+                metrics.filtered[i] += counts->filtered[i];
+            }
+        }
+    }
+
+    /**
+      Formats a duration in nanoseconds for the statistics.
+      */
+    QString formatLimit(qint64 nsecs)
+    {
+        if(nsecs < 0)
+            return "more";
+        if(nsecs < 1000000)
+            return QString("%1 us").arg(nsecs / 1000);
+        return QString("%1 ms").arg(nsecs / 1000000);
+    }
+
+    /**
+      Formats the counts of each level for the statistics.
+      */
+    QString formatLevels(const qint64 *counts)
+    {
+        QStringList levels;
+        for(int i = DEBUG; i < NONE; i++)
+            levels << QString::number(counts[i]);
+        return levels.join("/");
+    }
+}
+
+LogMetrics::LogMetrics()
+    : bytesWritten(0), lockWaits(0), lockWaitTime(0), truncations(0), queueDepth(0)
+{
+    for(int i = DEBUG; i < NONE; i++) {
+        accepted[i] = 0;
+        filtered[i] = 0;
+        dropped[i] = 0;
+    }
+    for(int i = 0; i < LATENCY_BUCKETS; i++) {
+        writeLatency[i] = 0;
+        flushLatency[i] = 0;
+    }
+}
+
+int LogMetrics::bucket(qint64 nsecs)
+{
+    int bucket = 0;
+    for(qint64 usecs = nsecs / 1000; usecs && bucket < LATENCY_BUCKETS - 1; usecs >>= 1)
+        ++bucket;
+    return bucket;
+}
+
+qint64 LogMetrics::bucketLimit(int bucket)
+{
+    if(bucket >= LATENCY_BUCKETS - 1)
+        return -1;
+    return (Q_INT64_C(1) << bucket) * 1000;
+}
+
+qint64 LogMetrics::percentile(const qint64 *histogram, int percent)
+{
+    qint64 total = 0;
+    for(int i = 0; i < LATENCY_BUCKETS; i++)
+        total += histogram[i];
+    if(!total)
+        return 0;
+
+    // the smallest bucket below which at least percent of the durations fall.
+    qint64 wanted = (total * percent + 99) / 100;
+    qint64 seen = 0;
+    for(int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += histogram[i];
+        if(seen >= wanted)
+            return bucketLimit(i);
+    }
+    return -1;
+}
+
+QString LogMetrics::format() const
+{
+    return QString("Logger statistics: accepted %1, filtered %2, dropped %3 (DEBUG/INFO/WARNING/CRITICAL); "
+                   "%4 bytes written; write p50 < %5, p99 < %6; flush p50 < %7, p99 < %8; "
+                   "%9 lock waits taking %10 ms; %11 truncations; %12 queued.")
+            .arg(formatLevels(accepted), formatLevels(filtered), formatLevels(dropped))
+            .arg(bytesWritten)
+            .arg(formatLimit(percentile(writeLatency, 50)), formatLimit(percentile(writeLatency, 99)),
+                 formatLimit(percentile(flushLatency, 50)), formatLimit(percentile(flushLatency, 99)))
+            .arg(lockWaits)
+            .arg(lockWaitTime / 1000000)
+            .arg(truncations)
+            .arg(queueDepth);
+}
+
+MetricsCollector::MetricsCollector()
+{
+    mergeCounts(m_baseline);
+    m_statisticsAge.start();
+}
+
+void MetricsCollector::countAccepted(LogLevel level)
+{
+    if(level >= DEBUG && level < NONE)
+        count(threadCounts()->accepted, retiredAccepted, level);
+}
+
+void MetricsCollector::countFiltered(LogLevel level)
+{
+    if(level >= DEBUG && level < NONE)
+        count(threadCounts()->filtered, retiredFiltered, level);
+}
+
+void MetricsCollector::countWrite(qint64 nsecs, qint64 bytes)
+{
+    ++m_counts.writeLatency[LogMetrics::bucket(nsecs)];
+    m_counts.bytesWritten += bytes;
+}
+
+void MetricsCollector::countFlush(qint64 nsecs)
+{
+    ++m_counts.flushLatency[LogMetrics::bucket(nsecs)];
+}
+
+void MetricsCollector::countLockWait(qint64 nsecs)
+{
+    ++m_counts.lockWaits;
+    m_counts.lockWaitTime += nsecs;
+}
+
+void MetricsCollector::countTruncation()
+{
+    ++m_counts.truncations;
+}
+
+bool MetricsCollector::statisticsDue(int interval)
+{
+    if(interval <= 0 || m_statisticsAge.elapsed() < interval)
+        return false;
+    m_statisticsAge.restart();
+    return true;
+}
+
+LogMetrics MetricsCollector::snapshot() const
+{
+    LogMetrics metrics = m_counts;
+    mergeCounts(metrics);
+    for(int i = DEBUG; i < NONE; i++) {
+        metrics.accepted[i] -= m_baseline.accepted[i];
+        metrics.filtered[i] -= m_baseline.filtered[i];
+    }
+    return metrics;
+}
+
+qint64 MetricsCollector::nsecsElapsed(const DebugTimer &timer)
+{
+#if QT_VERSION >= 0x040800
+    return timer.nsecsElapsed();
+#else
+    return qint64(timer.elapsed()) * 1000000;
+#endif // QT_VERSION 0x040800
+}
+
+MetricsLocker::MetricsLocker(QMutex *mutex, MetricsCollector *collector)
+    : m_mutex(mutex)
+{
+    if(m_mutex->tryLock())
+        return;
+
+    DebugTimer timer;
+    timer.start();
+    m_mutex->lock();
+    // the mutex is the operational mutex, which the collector needs held.
+    collector->countLockWait(MetricsCollector::nsecsElapsed(timer));
+}
+
+MetricsLocker::~MetricsLocker()
+{
+    m_mutex->unlock();
+}
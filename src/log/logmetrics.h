@@ -0,0 +1,203 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogMetrics, what the Logger has done and what it has cost,
+  and of MetricsCollector, which counts it.
+  */
+
+#ifndef LOGMETRICS_H
+#define LOGMETRICS_H
+
+#include <QMutex>
+#include <QString>
+#include <QtGlobal>
+
+// for DebugTimer
+#include "debug.h"
+#include "export.h"
+#include "logger.h"
+
+/**
+  A snapshot of the Logger's own statistics since it was created, as
+  returned by Logger::metrics().
+  Latencies are kept as histograms of power of two buckets: bucket 0
+  counts durations below a microsecond, bucket i below 2^i microseconds,
+  and the last bucket everything longer.
+  */
+struct LOGGER_EXPORT LogMetrics
+{
+    /// the number of buckets in a latency histogram.
+    static const int LATENCY_BUCKETS = 24;
+
+    /**
+      Constructor.
+      Sets every count to zero.
+      */
+    LogMetrics();
+
+    /**
+      Returns the bucket of a latency histogram a duration is counted in.
+      @param nsecs the duration in nanoseconds.
+      */
+    static int bucket(qint64 nsecs);
+    /**
+      Returns the upper bound of the durations counted in a bucket, in
+      nanoseconds, or -1 for the last bucket, which has none.
+      */
+    static qint64 bucketLimit(int bucket);
+    /**
+      Returns the upper bound of the bucket holding the given percentile
+      of a latency histogram, in nanoseconds.
+      @param histogram writeLatency or flushLatency.
+      @param percent the percentile, e.g. 99.
+      @returns the upper bound, 0 if the histogram is empty, or -1 if the
+      percentile falls in the last bucket.
+      */
+    static qint64 percentile(const qint64 *histogram, int percent);
+
+    /**
+      Formats the metrics as a single line of text, as written by the
+      periodic statistics.
+      */
+    QString format() const;
+
+    /// messages of each level handed to the outputs.
+    qint64 accepted[NONE];
+    /// messages of each level which reached the Logger, but were below the
+    /// threshold. Those filtered out by the LOG_* macros are not counted.
+    qint64 filtered[NONE];
+    /// messages of each level dropped because the queue was full.
+    qint64 dropped[NONE];
+    /// bytes written to the log file.
+    qint64 bytesWritten;
+    /// how long writes to the log file took.
+    qint64 writeLatency[LATENCY_BUCKETS];
+    /// how long flushing the log file and the console took.
+    qint64 flushLatency[LATENCY_BUCKETS];
+    /// how many times a thread had to wait for the operational mutex.
+    qint64 lockWaits;
+    /// how long threads waited for the operational mutex in all, in nanoseconds.
+    qint64 lockWaitTime;
+    /// how many times the log file was truncated because of the log limit.
+    qint64 truncations;
+    /// how many messages were queued for the writer thread, if there is one.
+    int queueDepth;
+};
+
+/**
+  Counts what the Logger does.
+  Messages are counted by the thread logging them, in counters of its own,
+  so counting needs neither a lock nor an atomic operation. The counters
+  of all threads are merged when a snapshot is taken, which may miss
+  increments still in flight. Everything else is counted with the
+  operational mutex held, where the work being counted happens anyway.
+  */
+class MetricsCollector
+{
+public:
+    /**
+      Constructor.
+      Messages counted before the collector was created are left out of
+      its snapshots.
+      */
+    MetricsCollector();
+
+    /**
+      Counts a message handed to the outputs by the calling thread.
+      */
+    static void countAccepted(LogLevel level);
+    /**
+      Counts a message filtered out by the calling thread.
+      */
+    static void countFiltered(LogLevel level);
+
+    /**
+      Counts a write to the log file.
+      The operational mutex must be held when calling this, as for the
+      other counts below.
+      @param nsecs how long the write took.
+      @param bytes how many bytes were written.
+      */
+    void countWrite(qint64 nsecs, qint64 bytes);
+    /**
+      Counts a flush of the log file and the console.
+      */
+    void countFlush(qint64 nsecs);
+    /**
+      Counts a wait for the operational mutex.
+      */
+    void countLockWait(qint64 nsecs);
+    /**
+      Counts a truncation of the log file.
+      */
+    void countTruncation();
+    /**
+      Is it time for the periodic statistics? If so, the interval restarts.
+      @param interval the interval of the statistics in ms, 0 if disabled.
+      */
+    bool statisticsDue(int interval);
+
+    /**
+      Returns what has been counted since the collector was created.
+      The queue and the drops are left to the caller.
+      */
+    LogMetrics snapshot() const;
+
+    /**
+      Returns the time on a timer in nanoseconds, as precisely as Qt allows.
+      */
+    static qint64 nsecsElapsed(const DebugTimer &timer);
+
+private:
+    /// what has been counted with the operational mutex held.
+    LogMetrics m_counts;
+    /// the messages counted before the collector was created.
+    LogMetrics m_baseline;
+    /// the time since the last periodic statistics.
+    DebugTimer m_statisticsAge;
+};
+
+/**
+  Locks a mutex for the scope of the locker, like QMutexLocker, and counts
+  the time spent waiting for it. An uncontended lock is not timed at all.
+  */
+class MetricsLocker
+{
+public:
+    /**
+      Constructor.
+      Locks the mutex.
+      @param mutex the mutex to lock.
+      @param collector where to count the wait.
+      */
+    MetricsLocker(QMutex *mutex, MetricsCollector *collector);
+    /**
+      Destructor.
+      Unlocks the mutex.
+      */
+    ~MetricsLocker();
+
+private:
+    /// the mutex held.
+    QMutex *m_mutex;
+};
+
+#endif // LOGMETRICS_H
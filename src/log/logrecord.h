@@ -0,0 +1,102 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of LogRecord, a single message on its way to the log.
+  */
+
+#ifndef LOGRECORD_H
+#define LOGRECORD_H
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+
+#include "logger.h"
+#include "timestamp.h"
+
+class LogCategory;
+
+/**
+  A single log message, captured at the time it was logged.
+  Everything that depends on the calling thread (the time, the thread
+  and the indentation) is recorded here, so the record can be formatted
+  and written later, possibly by a different thread.
+  */
+struct LogRecord
+{
+    /**
+      Default constructor.
+      Needed to store records in Qt containers.
+      */
+    LogRecord()
+        : level(NONE), time(0), thread(0), indent(0), category(0)
+    {
+    }
+
+    /**
+      Constructor.
+      Captures the current time, thread and indentation along with the message.
+      @param level the priority of the log message.
+      @param message the message to log.
+      @param indent the number of spaces to indent DEBUG messages with.
+      */
+    LogRecord(LogLevel level, const QString &message, unsigned short indent)
+        : level(level), time(currentTime()), thread(currentThread()), indent(indent), message(message),
+          category(0)
+    {
+    }
+
+    /**
+      Returns the current time in nanoseconds since the epoch, UTC.
+      */
+    static qint64 currentTime()
+    {
+        return Timestamp::now();
+    }
+
+    /**
+      Returns an identifier for the calling thread.
+      */
+    static quint64 currentThread()
+    {
+        return quint64(quintptr(QThread::currentThreadId()));
+    }
+
+    /// the priority of the message.
+    LogLevel level;
+    /// when the message was logged, in nanoseconds since the epoch.
+    qint64 time;
+    /// the thread the message was logged from.
+    quint64 thread;
+    /// the indentation of the message, only used for DEBUG.
+    unsigned short indent;
+    /// the message itself.
+    QString message;
+    /// the record in the binary log format, if the Logger writes that format.
+    QByteArray encoded;
+    /// the structured fields of the message as JSON object members, if any.
+    QByteArray fields;
+    /// the category the message was logged in, if any.
+    const LogCategory *category;
+};
+
+#endif // LOGRECORD_H
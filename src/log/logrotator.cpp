@@ -0,0 +1,135 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of LogRotator.
+  */
+#include "logrotator.h"
+
+#include <QFile>
+
+namespace {
+    /// the CRC-32 used by gzip.
+    quint32 crc32(const QByteArray &data)
+    {
+        static quint32 table[256];
+        static bool initialised = false;
+        if(!initialised) {
+            // racing threads compute the same table, so this is harmless
+            for(quint32 i = 0; i < 256; i++) {
+                quint32 c = i;
+                for(int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            initialised = true;
+        }
+
+        quint32 crc = 0xffffffffu;
+        const uchar *p = reinterpret_cast<const uchar *>(data.constData());
+        for(int i = 0; i < data.size(); i++)
+            crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+        return crc ^ 0xffffffffu;
+    }
+
+    void appendLittleEndian(QByteArray &out, quint32 value)
+    {
+        for(int i = 0; i < 4; i++)
+            out.append(char((value >> (8 * i)) & 0xff));
+    }
+}
+
+LogRotator::LogRotator(const QString &path, const QString &rotated, int generations)
+    : m_path(path), m_rotated(rotated), m_generations(generations)
+{
+}
+
+void LogRotator::run()
+{
+    if(m_generations < 1) {
+        QFile::remove(m_rotated);
+        return;
+    }
+
+    // make room for the newest generation
+    QFile::remove(generationPath(m_path, m_generations));
+    for(int i = m_generations - 1; i > 0; i--) {
+        QString older = generationPath(m_path, i);
+        if(QFile::exists(older))
+            QFile::rename(older, generationPath(m_path, i + 1));
+    }
+
+    QFile rotated(m_rotated);
+    if(!rotated.open(QIODevice::ReadOnly))
+        return;
+
+    QFile generation(generationPath(m_path, 1));
+    if(generation.open(QIODevice::WriteOnly | QIODevice::Truncate)
+            && compress(rotated, generation)) {
+        generation.close();
+        rotated.close();
+        rotated.remove();
+    }
+    else {
+        // keep the uncompressed file where it is rather than lose it.
+        // Its name is unique, so nobody will overwrite it either.
+        generation.remove();
+    }
+}
+
+bool LogRotator::compress(QIODevice &in, QIODevice &out)
+{
+    // a gzip file may hold several members, which are decompressed as one,
+    // so compressing chunk by chunk keeps only a chunk in memory at a time.
+    forever {
+        QByteArray chunk = in.read(CHUNK_SIZE);
+        if(chunk.isEmpty())
+            return in.atEnd();
+        QByteArray member = gzip(chunk);
+        if(member.isEmpty() || out.write(member) != member.size())
+            return false;
+    }
+}
+
+QString LogRotator::generationPath(const QString &path, int generation)
+{
+    return QString("%1.%2.gz").arg(path).arg(generation);
+}
+
+QByteArray LogRotator::gzip(const QByteArray &data)
+{
+    // qCompress gives us a 4 byte length, a 2 byte zlib header, the deflate
+    // stream and a 4 byte adler32. gzip wants the same deflate stream
+    // wrapped in a different header and trailer.
+    QByteArray zlib = qCompress(data);
+    if(zlib.size() < 10)
+        return QByteArray();
+
+    QByteArray out;
+    out.reserve(zlib.size() + 12);
+    // magic, deflate, no flags, no mtime, no extra flags, unknown OS
+    const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+    out.append(header, sizeof(header));
+    out.append(zlib.constData() + 6, zlib.size() - 10);
+    appendLittleEndian(out, crc32(data));
+    appendLittleEndian(out, quint32(data.size()));
+    return out;
+}
@@ -0,0 +1,93 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of LogRotator, which rotates and compresses old log files.
+  */
+
+#ifndef LOGROTATOR_H
+#define LOGROTATOR_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QRunnable>
+#include <QString>
+
+/**
+  A job which turns a rotated log file into the newest compressed generation.
+  The Logger only renames the full log file out of the way and opens a new one,
+  leaving everything else to this job: shifting app.log.1.gz to app.log.2.gz and
+  so on, dropping the oldest generation, and compressing the rotated file into
+  app.log.1.gz. Jobs must be run one at a time and in order, as each one shifts
+  the generations written by the previous one.
+  */
+class LogRotator : public QRunnable
+{
+public:
+    /**
+      Constructor.
+      @param path the path of the log file, e.g. /home/user/.app/app.log.
+      @param rotated the path the full log file was renamed to.
+      @param generations the number of compressed generations to keep.
+      */
+    LogRotator(const QString &path, const QString &rotated, int generations);
+
+    /**
+      Shifts the generations and compresses the rotated file.
+      */
+    void run();
+
+    /**
+      Returns the path of the given generation of a log file.
+      @param path the path of the log file.
+      @param generation the generation, starting at 1 for the newest.
+      */
+    static QString generationPath(const QString &path, int generation);
+
+    /**
+      Compresses data into the gzip format.
+      @param data the data to compress.
+      @return the gzip file contents.
+      */
+    static QByteArray gzip(const QByteArray &data);
+
+    /**
+      Compresses a file into the gzip format a chunk at a time, each chunk
+      making a member of its own.
+      @param in the file to compress.
+      @param out the device to write the compressed file to.
+      @return false if reading or writing failed.
+      */
+    static bool compress(QIODevice &in, QIODevice &out);
+
+private:
+    /// how much of the rotated file is compressed at a time.
+    static const qint64 CHUNK_SIZE = 1024 * 1024;
+
+    /// the path of the log file.
+    QString m_path;
+    /// the path of the rotated log file.
+    QString m_rotated;
+    /// the number of generations to keep.
+    int m_generations;
+};
+
+#endif // LOGROTATOR_H
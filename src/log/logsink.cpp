@@ -0,0 +1,57 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of LogSink.
+  */
+#include "logsink.h"
+
+LogSink::LogSink(LogLevel threshold, LogFormat format)
+    : m_threshold(threshold), m_format(format), m_logger(0)
+{
+}
+
+LogSink::~LogSink()
+{
+    // too late to remove ourselves: the subclass is already gone, while
+    // another thread may be inside write().
+    QMutexLocker locker(&Logger::m_operationalMutex);
+    Q_ASSERT(m_logger == 0);
+}
+
+void LogSink::setThreshold(LogLevel level)
+{
+    QMutexLocker locker(&Logger::m_operationalMutex);
+    m_threshold = level;
+
+    // the Logger may have to let more, or fewer, messages through now.
+    if(m_logger)
+        m_logger->updateEnabledThresholdLocked();
+}
+
+LogLevel LogSink::threshold() const
+{
+    return (LogLevel)(int)m_threshold;
+}
+
+LogFormat LogSink::format() const
+{
+    return m_format;
+}
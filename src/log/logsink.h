@@ -0,0 +1,98 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of LogSink, an output the Logger fans messages out to.
+  */
+
+#ifndef LOGSINK_H
+#define LOGSINK_H
+
+#include <QAtomicInt>
+#include <QByteArray>
+
+// for LogLevel and LogFormat
+#include "logger.h"
+
+/**
+  An output messages are written to in addition to the log file and the
+  console, e.g. a buffer in memory or a socket. Each sink has a threshold
+  of its own and receives messages in a format of its own. Sinks are
+  registered with Logger::addSink() at runtime.
+  A message is formatted at most once for each format in use, and handed
+  to every sink whose threshold it meets. The Logger lets a message through
+  if the log file or any of the sinks wants it, so a sink with a lower
+  threshold makes the lower levels cost as much as if the log file had it.
+  */
+class LOGGER_EXPORT LogSink
+{
+public:
+    /**
+      Constructor.
+      @param threshold the lowest level written to the sink.
+      @param format the format messages are handed to the sink in.
+      */
+    explicit LogSink(LogLevel threshold = DEBUG, LogFormat format = TEXT_FORMAT);
+    /**
+      Destructor.
+      The sink must have been removed with Logger::removeSink() before it
+      is deleted, since a subclass can no longer be written to once its own
+      destructor has run.
+      */
+    virtual ~LogSink();
+
+    /**
+      Sets the lowest level written to the sink.
+      @param level the new threshold.
+      @note must not be called from write().
+      */
+    void setThreshold(LogLevel level);
+    /**
+      Returns the lowest level written to the sink.
+      */
+    LogLevel threshold() const;
+    /**
+      Returns the format messages are handed to the sink in.
+      */
+    LogFormat format() const;
+
+    /**
+      Writes a single message to the sink.
+      Called with the operational mutex of the Logger held, from the thread
+      which logged the message or from the writer thread in asynchronous
+      mode. It should return quickly, and must not log.
+      @param level the level of the message.
+      @param data a line of text including the newline in the TEXT_FORMAT,
+      or a message record holding the text of the message in the BINARY_FORMAT.
+      */
+    virtual void write(LogLevel level, const QByteArray &data) = 0;
+
+private:
+    friend class Logger;
+
+    /// the lowest level written to the sink.
+    QAtomicInt m_threshold;
+    /// the format messages are handed to the sink in.
+    LogFormat m_format;
+    /// the Logger the sink is registered with, if any.
+    Logger *m_logger;
+};
+
+#endif // LOGSINK_H
@@ -0,0 +1,171 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of LogWriter.
+  */
+#include "logwriter.h"
+#include "logger.h"
+
+#include <QMutexLocker>
+
+LogWriter::LogWriter(Logger *logger, int capacity)
+    : m_logger(logger), m_capacity(capacity), m_stopping(false), m_writing(false)
+{
+    if(m_capacity < 1)
+        m_capacity = 1;
+    for(int i = DEBUG; i < NONE; i++) {
+        m_dropped[i] = 0;
+        m_unreported[i] = 0;
+    }
+}
+
+LogWriter::~LogWriter()
+{
+    stop();
+}
+
+bool LogWriter::enqueue(const LogRecord &record, OverflowPolicy policy)
+{
+    QMutexLocker locker(&m_mutex);
+
+    // the writer is gone, nothing will ever drain the queue.
+    if(m_stopping)
+        return false;
+
+    if(m_queue.size() >= m_capacity) {
+        switch(policy) {
+        case OVERFLOW_DROP_NEWEST:
+            countDrop(record.level);
+            return true;
+        case OVERFLOW_DROP_OLDEST:
+            countDrop(m_queue.dequeue().level);
+            break;
+        case OVERFLOW_DROP_BELOW_WARNING:
+            if(record.level < WARNING) {
+                countDrop(record.level);
+                return true;
+            }
+            // warnings and above are never dropped, fall through
+        case OVERFLOW_BLOCK:
+        default:
+            while(m_queue.size() >= m_capacity && !m_stopping)
+                m_notFull.wait(&m_mutex);
+            // stopped while we waited
+            if(m_stopping)
+                return false;
+            break;
+        }
+    }
+
+    m_queue.enqueue(record);
+    // only the first record of a batch needs to wake the writer.
+    if(m_queue.size() == 1)
+        m_notEmpty.wakeOne();
+    return true;
+}
+
+void LogWriter::countDrop(LogLevel level)
+{
+    if(level < DEBUG || level >= NONE)
+        return;
+    ++m_dropped[level];
+    ++m_unreported[level];
+}
+
+qint64 LogWriter::dropped(LogLevel level)
+{
+    QMutexLocker locker(&m_mutex);
+    return level >= DEBUG && level < NONE ? m_dropped[level] : 0;
+}
+
+int LogWriter::queueDepth()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_queue.size();
+}
+
+void LogWriter::flush()
+{
+    QMutexLocker locker(&m_mutex);
+
+    while((!m_queue.isEmpty() || m_writing) && isRunning())
+        m_written.wait(&m_mutex);
+}
+
+void LogWriter::stop()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stopping = true;
+        m_notEmpty.wakeOne();
+        // producers waiting for room write their records themselves.
+        m_notFull.wakeAll();
+    }
+    wait();
+}
+
+void LogWriter::run()
+{
+    QList<LogRecord> batch;
+    int unreported[NONE];
+
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            while(m_queue.isEmpty() && !m_stopping)
+                m_notEmpty.wait(&m_mutex);
+
+            if(m_queue.isEmpty())
+                break;
+
+            // take the whole queue, and let the producers go on while we write.
+            batch = m_queue;
+            m_queue.clear();
+            m_writing = true;
+            m_notFull.wakeAll();
+
+            // what was dropped is reported once the writer has caught up.
+            for(int i = DEBUG; i < NONE; i++) {
+                unreported[i] = m_unreported[i];
+                m_unreported[i] = 0;
+            }
+        }
+
+        int drops = 0;
+        for(int i = DEBUG; i < NONE; i++)
+            drops += unreported[i];
+        QString report;
+        if(drops) {
+            report = QString("%1 messages dropped while the log writer was behind "
+                             "(DEBUG: %2, INFO: %3, WARNING: %4, CRITICAL: %5).")
+                     .arg(drops).arg(unreported[DEBUG]).arg(unreported[INFO])
+                     .arg(unreported[WARNING]).arg(unreported[CRITICAL]);
+        }
+
+        m_logger->writeBatch(batch, report);
+        batch.clear();
+
+        QMutexLocker locker(&m_mutex);
+        m_writing = false;
+        m_written.wakeAll();
+    }
+}
@@ -0,0 +1,131 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of LogWriter, the background thread used by the asynchronous mode.
+  */
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QMutex>
+#include <QQueue>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "logrecord.h"
+
+class Logger;
+
+/**
+  A thread which drains queued log records to the Logger's outputs.
+  Any number of threads may enqueue() records. The queue is bounded:
+  if the writer falls too far behind, the overflow policy of the Logger
+  decides whether a producer blocks or a record is dropped. Dropped
+  records are counted by level, and reported with the next batch.
+  The writer takes the whole queue at once and hands it to the Logger
+  as a single batch, so the operational mutex is taken once per batch
+  rather than once per message.
+  */
+class LogWriter : public QThread
+{
+public:
+    /**
+      Constructor.
+      @param logger the Logger to write the records through.
+      @param capacity the maximum number of records to keep queued.
+      */
+    LogWriter(Logger *logger, int capacity);
+    /**
+      Destructor.
+      Stops the thread, writing any records left in the queue.
+      */
+    ~LogWriter();
+
+    /**
+      Adds a record to the queue.
+      If the queue is full, this either blocks until the writer has made
+      room or drops a record, depending on the policy.
+      @param record the record to write.
+      @param policy what to do if the queue is full.
+      @returns false if the writer has been stopped and the record was not
+      taken, in which case the caller has to write it.
+      */
+    bool enqueue(const LogRecord &record, OverflowPolicy policy);
+
+    /**
+      Returns how many records of a level have been dropped.
+      */
+    qint64 dropped(LogLevel level);
+
+    /**
+      Returns the number of records waiting in the queue.
+      */
+    int queueDepth();
+
+    /**
+      Waits until every record queued so far has been written.
+      */
+    void flush();
+
+    /**
+      Writes all queued records and stops the thread.
+      Returns once the thread has finished.
+      */
+    void stop();
+
+protected:
+    /**
+      The main loop of the writer thread.
+      */
+    void run();
+
+private:
+    /**
+      Counts a dropped record. The mutex must be held when calling this.
+      */
+    void countDrop(LogLevel level);
+
+    /// the logger we write through.
+    Logger *m_logger;
+    /// protects the queue and the stop flag.
+    QMutex m_mutex;
+    /// signalled when records are added, or when we are asked to stop.
+    QWaitCondition m_notEmpty;
+    /// signalled when the writer has emptied the queue.
+    QWaitCondition m_notFull;
+    /// signalled when the writer has written a batch.
+    QWaitCondition m_written;
+    /// the records waiting to be written.
+    QQueue<LogRecord> m_queue;
+    /// the maximum number of records in the queue.
+    int m_capacity;
+    /// set when the thread should drain the queue and exit.
+    bool m_stopping;
+    /// set while the writer writes a batch taken from the queue.
+    bool m_writing;
+    /// how many records of each level have been dropped in all.
+    qint64 m_dropped[NONE];
+    /// how many records of each level have been dropped since the last report.
+    int m_unreported[NONE];
+};
+
+#endif // LOGWRITER_H
@@ -0,0 +1,103 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of MappedFile.
+  */
+#include "mappedfile.h"
+
+#include <QFile>
+
+#include <cstring>
+
+MappedFile::MappedFile(qint64 chunkSize)
+    : m_chunkSize(chunkSize), m_size(0), m_map(0), m_mapOffset(0), m_mapSize(0)
+{
+}
+
+bool MappedFile::open(QFile &file)
+{
+    m_size = file.size();
+    return remap(file, 0);
+}
+
+bool MappedFile::write(QFile &file, const char *data, qint64 length)
+{
+    if(m_size + length > m_mapOffset + m_mapSize) {
+        if(!remap(file, length))
+            return false;
+    }
+
+    memcpy(m_map + (m_size - m_mapOffset), data, length);
+    m_size += length;
+    return true;
+}
+
+bool MappedFile::truncate(QFile &file)
+{
+    // drop the old content first, or remapping would leave it in the chunk
+    // beyond the new output, to be read back once the file is closed early.
+    if(m_map) {
+        file.unmap(m_map);
+        m_map = 0;
+    }
+    m_mapSize = 0;
+    m_size = 0;
+    if(!file.resize(0))
+        return false;
+    return remap(file, 0);
+}
+
+bool MappedFile::close(QFile &file)
+{
+    if(m_map) {
+        file.unmap(m_map);
+        m_map = 0;
+    }
+    m_mapSize = 0;
+    return file.resize(m_size);
+}
+
+qint64 MappedFile::size() const
+{
+    return m_size;
+}
+
+bool MappedFile::remap(QFile &file, qint64 needed)
+{
+    if(m_map) {
+        file.unmap(m_map);
+        m_map = 0;
+    }
+    m_mapOffset = m_size;
+    m_mapSize = 0;
+
+    qint64 size = qMax(m_chunkSize, needed);
+    if(!file.resize(m_size + size))
+        return false;
+
+    // QFile takes care of aligning the offset to a page
+    m_map = file.map(m_size, size);
+    if(!m_map)
+        return false;
+    m_mapSize = size;
+    return true;
+}
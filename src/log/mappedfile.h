@@ -0,0 +1,101 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of MappedFile, which writes log output through a memory mapping.
+  */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QtGlobal>
+
+class QFile;
+
+/**
+  Writes output to a file through a memory mapping.
+  The file is extended and mapped a chunk at a time, so writing output is
+  a memcpy into the page cache rather than a system call per message. When
+  a chunk fills up, the file is extended by another chunk and the mapping
+  moved along. Until close() trims the file to the output actually written,
+  the file ends in zeros.
+  */
+class MappedFile
+{
+public:
+    /**
+      Constructor.
+      @param chunkSize the number of bytes to extend and map the file by.
+      */
+    explicit MappedFile(qint64 chunkSize);
+
+    /**
+      Starts writing at the end of an open file.
+      @param file the file, opened for reading and writing.
+      @return false if the file could not be mapped.
+      */
+    bool open(QFile &file);
+    /**
+      Copies output into the mapping, extending and remapping the file as needed.
+      @param file the file given to open().
+      @param data the output to write.
+      @param length the number of bytes to write.
+      @return false if the file could not be extended or remapped.
+      */
+    bool write(QFile &file, const char *data, qint64 length);
+    /**
+      Discards everything written so far.
+      @param file the file given to open().
+      @return false if the file could not be truncated or remapped.
+      */
+    bool truncate(QFile &file);
+    /**
+      Removes the mapping and trims the file to the output written.
+      @param file the file given to open().
+      @return false if the file could not be trimmed.
+      */
+    bool close(QFile &file);
+
+    /**
+      Returns the number of bytes of output in the file.
+      */
+    qint64 size() const;
+
+private:
+    /**
+      Extends the file and maps the next chunk, starting at the end of the output.
+      @param needed the minimum number of bytes the new mapping must hold.
+      */
+    bool remap(QFile &file, qint64 needed);
+
+    /// the number of bytes to extend and map the file by.
+    qint64 m_chunkSize;
+    /// the number of bytes of output in the file.
+    qint64 m_size;
+    /// the current mapping, if any.
+    uchar *m_map;
+    /// the offset into the file of the current mapping.
+    qint64 m_mapOffset;
+    /// the size of the current mapping.
+    qint64 m_mapSize;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,70 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Implementation of MemorySink.
+  */
+#include "memorysink.h"
+
+#include <QMutexLocker>
+
+MemorySink::MemorySink(int capacity, LogLevel threshold, LogFormat format)
+    : LogSink(threshold, format), m_capacity(capacity)
+{
+}
+
+void MemorySink::write(LogLevel level, const QByteArray &data)
+{
+    Q_UNUSED(level);
+
+    if(m_capacity <= 0)
+        return;
+
+    QMutexLocker locker(&m_mutex);
+    if(m_messages.size() >= m_capacity)
+        m_messages.removeFirst();
+    m_messages.append(data);
+}
+
+QList<QByteArray> MemorySink::messages() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_messages;
+}
+
+QByteArray MemorySink::contents() const
+{
+    QMutexLocker locker(&m_mutex);
+    QByteArray contents;
+    foreach(const QByteArray &message, m_messages)
+        contents.append(message);
+    return contents;
+}
+
+void MemorySink::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_messages.clear();
+}
+
+int MemorySink::capacity() const
+{
+    return m_capacity;
+}
@@ -0,0 +1,83 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+/**
+  @file
+
+  Declaration of MemorySink, a sink keeping the newest messages in memory.
+  */
+
+#ifndef MEMORYSINK_H
+#define MEMORYSINK_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+
+#include "logsink.h"
+
+/**
+  A sink keeping the newest messages in memory, e.g. to keep DEBUG
+  messages around for when something goes wrong, while only WARNING
+  and above are written to the log file. Once the sink holds its
+  capacity of messages, the oldest one is dropped for each new one.
+  */
+class LOGGER_EXPORT MemorySink : public LogSink
+{
+public:
+    /**
+      Constructor.
+      @param capacity the number of messages kept.
+      @param threshold the lowest level kept.
+      @param format the format the messages are kept in.
+      */
+    explicit MemorySink(int capacity, LogLevel threshold = DEBUG,
+                        LogFormat format = TEXT_FORMAT);
+
+    /**
+      Keeps the message, dropping the oldest one if the sink is full.
+      */
+    virtual void write(LogLevel level, const QByteArray &data);
+
+    /**
+      Returns the messages kept, oldest first.
+      */
+    QList<QByteArray> messages() const;
+    /**
+      Returns the messages kept, oldest first, joined into one array.
+      */
+    QByteArray contents() const;
+    /**
+      Drops all messages kept.
+      */
+    void clear();
+    /**
+      Returns the number of messages kept at most.
+      */
+    int capacity() const;
+
+private:
+    /// protects the messages, which are read from other threads.
+    mutable QMutex m_mutex;
+    /// the messages kept, oldest first.
+    QList<QByteArray> m_messages;
+    /// the number of messages kept at most.
+    int m_capacity;
+};
+
+#endif // MEMORYSINK_H
@@ -0,0 +1,147 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of RingFile.
+  */
+#include "ringfile.h"
+#include "binaryformat.h"
+
+#include <QFile>
+
+#include <cstring>
+
+namespace {
+    const char RING_MAGIC[8] = { 'L', 'O', 'G', 'R', 'I', 'N', 'G', '\n' };
+    const quint32 RING_VERSION = 1;
+    /// the size of the chunks of zeros written when allocating the file.
+    const qint64 ALLOCATION_CHUNK = 64 * 1024;
+
+    bool readHeader(const char *data, qint64 size, RingFile::Header &header)
+    {
+        if(size < qint64(sizeof(header)))
+            return false;
+        memcpy(&header, data, sizeof(header));
+        return !memcmp(header.magic, RING_MAGIC, sizeof(header.magic))
+                && header.byteOrder == BinaryLog::BYTE_ORDER_MARK
+                && header.version == RING_VERSION
+                && header.head < header.dataSize;
+    }
+}
+
+RingFile::RingFile()
+{
+    memset(&m_header, 0, sizeof(m_header));
+}
+
+bool RingFile::open(QFile &file, qint64 dataSize)
+{
+    if(dataSize <= 0)
+        return false;
+
+    // continue an existing ring of the same size
+    Header existing;
+    QByteArray start = file.read(sizeof(existing));
+    if(readHeader(start.constData(), start.size(), existing)
+            && existing.dataSize == quint64(dataSize)
+            && file.size() == qint64(sizeof(existing)) + dataSize) {
+        m_header = existing;
+        return true;
+    }
+
+    memcpy(m_header.magic, RING_MAGIC, sizeof(m_header.magic));
+    m_header.byteOrder = BinaryLog::BYTE_ORDER_MARK;
+    m_header.version = RING_VERSION;
+    m_header.dataSize = dataSize;
+    m_header.head = 0;
+    m_header.wrapped = 0;
+    m_header.reserved = 0;
+
+    // allocate the whole file up front, so it never has to grow later
+    if(!file.resize(0) || !writeHeader(file))
+        return false;
+    QByteArray zeros(qMin(dataSize, ALLOCATION_CHUNK), '\0');
+    for(qint64 left = dataSize; left > 0; left -= zeros.size()) {
+        if(file.write(zeros.constData(), qMin(left, qint64(zeros.size()))) < 0)
+            return false;
+    }
+    return file.flush();
+}
+
+bool RingFile::write(QFile &file, const QByteArray &data)
+{
+    const char *p = data.constData();
+    qint64 length = data.size();
+    qint64 dataSize = m_header.dataSize;
+
+    // only the newest output fits
+    if(length > dataSize) {
+        p += length - dataSize;
+        length = dataSize;
+    }
+
+    while(length > 0) {
+        qint64 chunk = qMin(length, qint64(dataSize - m_header.head));
+        if(!file.seek(sizeof(m_header) + m_header.head) || file.write(p, chunk) != chunk)
+            return false;
+        m_header.head += chunk;
+        if(m_header.head == quint64(dataSize)) {
+            m_header.head = 0;
+            m_header.wrapped = 1;
+        }
+        p += chunk;
+        length -= chunk;
+    }
+
+    return writeHeader(file);
+}
+
+bool RingFile::writeHeader(QFile &file)
+{
+    return file.seek(0)
+            && file.write(reinterpret_cast<const char *>(&m_header), sizeof(m_header)) == sizeof(m_header);
+}
+
+bool RingFile::isRing(const char *data, qint64 size)
+{
+    Header header;
+    return readHeader(data, size, header);
+}
+
+QByteArray RingFile::unwrap(const char *data, qint64 size)
+{
+    Header header;
+    if(!readHeader(data, size, header) || size < qint64(sizeof(header) + header.dataSize))
+        return QByteArray();
+
+    const char *ring = data + sizeof(header);
+    QByteArray out;
+    if(header.wrapped) {
+        // the oldest output starts at the head, most likely mid-line
+        const char *oldest = ring + header.head;
+        qint64 oldestSize = header.dataSize - header.head;
+        const char *newline = static_cast<const char *>(memchr(oldest, '\n', oldestSize));
+        if(newline)
+            out.append(newline + 1, oldestSize - (newline + 1 - oldest));
+    }
+    out.append(ring, header.head);
+    return out;
+}
@@ -0,0 +1,118 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of RingFile, a fixed-size log file written as a circular buffer.
+  */
+
+#ifndef RINGFILE_H
+#define RINGFILE_H
+
+#include <QByteArray>
+#include <QtGlobal>
+
+#include "export.h"
+
+class QFile;
+
+/**
+  A log file of a fixed size, written as a circular buffer.
+  The file is allocated once, when it is created, and consists of a small
+  Header followed by the data area. Output is written at the head of the data
+  area, wrapping around to the start when it reaches the end, so the file
+  always holds the newest output and never grows. The header records where
+  the head is, so an existing ring is continued rather than started over
+  when the program restarts, and a reader can put the output back in
+  chronological order with unwrap().
+  */
+class LOGGER_EXPORT RingFile
+{
+public:
+    /**
+      The header at the start of a ring file.
+      */
+    struct Header {
+        /// always "LOGRING\n".
+        char magic[8];
+        /// BinaryLog::BYTE_ORDER_MARK, in the byte order of the writer.
+        quint32 byteOrder;
+        /// the version of the format.
+        quint32 version;
+        /// the size of the data area following the header.
+        quint64 dataSize;
+        /// the offset into the data area where the next output goes.
+        quint64 head;
+        /// non-zero once the head has wrapped around at least once.
+        quint32 wrapped;
+        /// unused, always zero.
+        quint32 reserved;
+    };
+
+    /**
+      Constructor.
+      */
+    RingFile();
+
+    /**
+      Prepares an open file for use as a ring with the given data size.
+      If the file already is a ring of that size, writing continues where
+      it left off. Otherwise the file is allocated and initialised.
+      @param file the file, opened for reading and writing.
+      @param dataSize the size of the data area.
+      @return false if the file could not be prepared.
+      */
+    bool open(QFile &file, qint64 dataSize);
+
+    /**
+      Writes output at the head of the ring and updates the header.
+      If the output is larger than the ring, only its end is kept.
+      @param file the file given to open().
+      @param data the output to write.
+      @return false if the file could not be written.
+      */
+    bool write(QFile &file, const QByteArray &data);
+
+    /**
+      Is the given data the start of a ring file?
+      @param data the start of the file.
+      @param size the number of bytes available at data.
+      */
+    static bool isRing(const char *data, qint64 size);
+    /**
+      Returns the output in a ring file in chronological order.
+      If the ring has wrapped, the partial line at the start of the oldest
+      output is dropped.
+      @param data the contents of the ring file.
+      @param size the size of the ring file.
+      */
+    static QByteArray unwrap(const char *data, qint64 size);
+
+private:
+    /**
+      Writes the header to the start of the file.
+      */
+    bool writeHeader(QFile &file);
+
+    /// the current header.
+    Header m_header;
+};
+
+#endif // RINGFILE_H
@@ -0,0 +1,193 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Implementation of Timestamp.
+  */
+#include "timestamp.h"
+
+#include <QDate>
+#include <QDateTime>
+#include <QThreadStorage>
+#include <QTime>
+
+#include <cstring>
+
+#if defined(Q_OS_WIN)
+#   include <windows.h>
+#elif defined(Q_OS_MAC)
+#   include <sys/time.h>
+#elif defined(Q_OS_UNIX)
+#   include <time.h>
+#endif
+
+namespace {
+    const qint64 NSECS_PER_SEC = Q_INT64_C(1000000000);
+
+    /**
+      The text of the second a thread formatted last.
+      */
+    struct SecondCache {
+        SecondCache()
+            : second(-1), format(TIME_OF_DAY), utc(false), length(0)
+        {
+            text[0] = '\0';
+        }
+
+        /// the second, in seconds since the epoch.
+        qint64 second;
+        /// the format the text was written in.
+        TimeFormat format;
+        /// was the text written in UTC?
+        bool utc;
+        /// the length of the text.
+        int length;
+        /// the formatted second, e.g. "2011-06-01T21:04:01".
+        char text[Timestamp::MAX_LENGTH + 1];
+    };
+
+    QThreadStorage<SecondCache *> secondCaches;
+
+    /**
+      Writes a value as exactly width decimal digits, padded with zeros.
+      */
+    char *putDigits(char *out, qint64 value, int width)
+    {
+        for(int i = width - 1; i >= 0; i--) {
+            out[i] = char('0' + value % 10);
+            value /= 10;
+        }
+        return out + width;
+    }
+
+    /**
+      Formats the whole seconds of a time.
+      @returns the length of the text written.
+      */
+    int formatSecond(qint64 second, TimeFormat format, bool utc, char *out)
+    {
+        QDateTime dateTime = QDateTime::fromTime_t(uint(second));
+        if(utc)
+            dateTime = dateTime.toUTC();
+        QDate date = dateTime.date();
+        QTime time = dateTime.time();
+
+        char *p = out;
+        if(format != TIME_OF_DAY) {
+            p = putDigits(p, date.year(), 4);
+            *p++ = '-';
+            p = putDigits(p, date.month(), 2);
+            *p++ = '-';
+            p = putDigits(p, date.day(), 2);
+            *p++ = 'T';
+        }
+        p = putDigits(p, time.hour(), 2);
+        *p++ = ':';
+        p = putDigits(p, time.minute(), 2);
+        *p++ = ':';
+        p = putDigits(p, time.second(), 2);
+        *p = '\0';
+        return p - out;
+    }
+}
+
+qint64 Timestamp::now()
+{
+#if defined(Q_OS_WIN)
+    // 100 ns intervals since 1601-01-01
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+    qint64 ticks = (qint64(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+    return (ticks - Q_INT64_C(116444736000000000)) * 100;
+#elif defined(Q_OS_MAC)
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return qint64(tv.tv_sec) * NSECS_PER_SEC + qint64(tv.tv_usec) * 1000;
+#elif defined(Q_OS_UNIX)
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return qint64(ts.tv_sec) * NSECS_PER_SEC + ts.tv_nsec;
+#else
+#   if QT_VERSION >= 0x040700
+    return QDateTime::currentMSecsSinceEpoch() * 1000000;
+#   else
+    QDateTime now = QDateTime::currentDateTime();
+    return (qint64(now.toTime_t()) * 1000 + now.time().msec()) * 1000000;
+#   endif // QT_VERSION 0x040700
+#endif
+}
+
+int Timestamp::format(qint64 time, TimeFormat format, bool utc, char *out)
+{
+    if(format == EPOCH_NANOSECONDS) {
+        // write the digits backwards, then move them into place
+        char digits[MAX_LENGTH];
+        char *p = digits + sizeof(digits);
+        quint64 value = time < 0 ? quint64(-time) : quint64(time);
+        do {
+            *--p = char('0' + value % 10);
+            value /= 10;
+        } while(value);
+        if(time < 0)
+            *--p = '-';
+        int length = digits + sizeof(digits) - p;
+        memcpy(out, p, length);
+        out[length] = '\0';
+        return length;
+    }
+
+    qint64 second = time / NSECS_PER_SEC;
+    qint64 fraction = time % NSECS_PER_SEC;
+    if(fraction < 0) {
+        second--;
+        fraction += NSECS_PER_SEC;
+    }
+
+    // the date and time of day only change once a second
+    if(!secondCaches.hasLocalData())
+        secondCaches.setLocalData(new SecondCache);
+    SecondCache *cache = secondCaches.localData();
+    if(cache->second != second || cache->format != format || cache->utc != utc) {
+        cache->second = second;
+        cache->format = format;
+        cache->utc = utc;
+        cache->length = formatSecond(second, format, utc, cache->text);
+    }
+
+    memcpy(out, cache->text, cache->length);
+    char *p = out + cache->length;
+    switch(format) {
+    case ISO_MILLISECONDS:
+        *p++ = '.';
+        p = putDigits(p, fraction / 1000000, 3);
+        break;
+    case ISO_MICROSECONDS:
+        *p++ = '.';
+        p = putDigits(p, fraction / 1000, 6);
+        break;
+    default:
+        break;
+    }
+    if(utc && format != TIME_OF_DAY)
+        *p++ = 'Z';
+    *p = '\0';
+    return p - out;
+}
@@ -0,0 +1,66 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+/**
+  @file
+
+  Declaration of Timestamp, the clock and time formatting used for log messages.
+  */
+
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <QtGlobal>
+
+#include "export.h"
+#include "logger.h"
+
+/**
+  Reads the clock and formats times for the log.
+  Formatting a time is dominated by breaking it down into a date and a time
+  of day, which only changes once a second. Each thread therefore keeps the
+  text of the current second around, and only the fraction of the second is
+  formatted for every message. No memory is allocated on either path.
+  */
+class LOGGER_EXPORT Timestamp
+{
+public:
+    /// the longest text format() writes, not counting the terminating NUL.
+    static const int MAX_LENGTH = 32;
+
+    /**
+      Returns the current time in nanoseconds since the epoch, UTC.
+      The resolution depends on the platform, but is at least a microsecond
+      on all Unix systems.
+      */
+    static qint64 now();
+
+    /**
+      Formats a time.
+      @param time the time in nanoseconds since the epoch.
+      @param format how to format the time.
+      @param utc true to print the time in UTC, false for local time.
+      Ignored for EPOCH_NANOSECONDS.
+      @param out where to write the text, at least MAX_LENGTH + 1 bytes.
+      @returns the length of the text written, which is NUL terminated.
+      */
+    static int format(qint64 time, TimeFormat format, bool utc, char *out);
+};
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,107 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+#include "test_binaryformat.h"
+#include "log/logrecord.h"
+
+#include <cstring>
+
+QByteArray TestBinaryFormat::roundTrip(const char *format, ...)
+{
+    QByteArray args;
+    va_list ap;
+    va_start(ap, format);
+    BinaryLog::appendArguments(args, format, ap);
+    va_end(ap);
+
+    return BinaryLog::formatArguments(format, args.constData(), args.size());
+}
+
+void TestBinaryFormat::testFileHeader()
+{
+    BinaryLog::FileHeader header = BinaryLog::fileHeader();
+    const char *data = reinterpret_cast<const char *>(&header);
+    QVERIFY(BinaryLog::isValid(data, sizeof(header)));
+    // a short read is not a valid header
+    QVERIFY(!BinaryLog::isValid(data, sizeof(header) - 1));
+    // and neither is a text log
+    QVERIFY(!BinaryLog::isValid("[21:04:01] [DEBUG]    Entering", 30));
+}
+
+void TestBinaryFormat::testIntegers()
+{
+    QCOMPARE(roundTrip("%d", 42), QByteArray("42"));
+    QCOMPARE(roundTrip("%5d|%-5d|", -7, 7), QByteArray("   -7|7    |"));
+    QCOMPARE(roundTrip("%u %x %X %o", 10u, 255u, 255u, 8u), QByteArray("10 ff FF 10"));
+    QCOMPARE(roundTrip("%ld %lld", -1L, Q_INT64_C(-9000000000)), QByteArray("-1 -9000000000"));
+    QCOMPARE(roundTrip("%hd", 65537), QByteArray("1"));
+    QCOMPARE(roundTrip("%c%c", 'o', 'k'), QByteArray("ok"));
+    QCOMPARE(roundTrip("%08x", 0xbeefu), QByteArray("0000beef"));
+}
+
+void TestBinaryFormat::testFloatingPoint()
+{
+    QCOMPARE(roundTrip("%.2f", 3.14159), QByteArray("3.14"));
+    QCOMPARE(roundTrip("%g", 0.5), QByteArray("0.5"));
+    QCOMPARE(roundTrip("%e", 1000.0), QByteArray("1.000000e+03"));
+}
+
+void TestBinaryFormat::testStrings()
+{
+    QCOMPARE(roundTrip("Entering %s.", "foo"), QByteArray("Entering foo."));
+    QCOMPARE(roundTrip("%.3s", "truncated"), QByteArray("tru"));
+    QCOMPARE(roundTrip("[%6s]", "ab"), QByteArray("[    ab]"));
+    QCOMPARE(roundTrip("%s", (const char *)0), QByteArray("(null)"));
+}
+
+void TestBinaryFormat::testStarArguments()
+{
+    QCOMPARE(roundTrip("%*d", 4, 1), QByteArray("   1"));
+    QCOMPARE(roundTrip("%.*f", 1, 2.25), QByteArray("2.2"));
+    QCOMPARE(roundTrip("%.*s", 2, "abc"), QByteArray("ab"));
+}
+
+void TestBinaryFormat::testLiteralText()
+{
+    QCOMPARE(roundTrip("no arguments"), QByteArray("no arguments"));
+    QCOMPARE(roundTrip("100%% sure"), QByteArray("100% sure"));
+    // formatting stops at conversions that cannot be stored
+    QCOMPARE(roundTrip("stop %n here", (int *)0), QByteArray("stop "));
+}
+
+void TestBinaryFormat::testMessageRecord()
+{
+    LogRecord record(WARNING, "a literal message", 4);
+    QByteArray encoded = BinaryLog::encodeMessage(record);
+
+    BinaryLog::RecordHeader header;
+    QVERIFY(encoded.size() > int(sizeof(header)));
+    memcpy(&header, encoded.constData(), sizeof(header));
+    QCOMPARE(int(header.size), encoded.size());
+    QCOMPARE(int(header.type), int(BinaryLog::MessageRecord));
+    QCOMPARE(int(header.level), int(WARNING));
+    QCOMPARE(int(header.indent), 4);
+    QCOMPARE(int(header.formatId), 0);
+    QCOMPARE(header.time, record.time);
+    QCOMPARE(header.thread, record.thread);
+    QCOMPARE(encoded.mid(sizeof(header)), QByteArray("a literal message"));
+}
+
+QTEST_MAIN(TestBinaryFormat)
+#include "test_binaryformat.moc"
@@ -0,0 +1,52 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+#ifndef TEST_BINARYFORMAT_H
+#define TEST_BINARYFORMAT_H
+
+#include <QTest>
+
+#include "log/binaryformat.h"
+
+class TestBinaryFormat : public QObject
+{
+    Q_OBJECT
+public:
+    TestBinaryFormat()
+    {
+    }
+    ~TestBinaryFormat() {};
+
+private slots:
+    void testFileHeader();
+
+    void testIntegers();
+    void testFloatingPoint();
+    void testStrings();
+    void testStarArguments();
+    void testLiteralText();
+
+    void testMessageRecord();
+
+private:
+    /// encodes the arguments for format, and formats them again.
+    QByteArray roundTrip(const char *format, ...);
+};
+
+#endif // TEST_BINARYFORMAT_H
@@ -20,6 +20,40 @@
 #include "test_debug.h"
 #include "common/setup.h"
 
+#include <QDir>
+#include <QFile>
+#include <QThread>
+
+namespace {
+    /**
+      Indents a few levels on a thread of its own.
+      */
+    class IndentThread : public QThread {
+    public:
+        IndentThread()
+            : indent(-1)
+        {
+        }
+
+        /// the indentation seen by the thread after pushing.
+        int indent;
+
+    protected:
+        void run()
+        {
+            for(int i = 0; i < 3; i++)
+                Debug::Indent::push();
+            indent = Debug::Indent::getIndent();
+        }
+    };
+
+    /// a function which would flood the log if it logged every call.
+    void sampledFunction()
+    {
+        LOG_FUNCTION_SAMPLED(1000, 0)
+    }
+}
+
 void TestDebug::initTestCase()
 {
     setupTests();
@@ -50,6 +84,18 @@ void TestDebug::testIndentPop()
     QCOMPARE((int)Debug::Indent::getIndent(), 0);
 }
 
+void TestDebug::testIndentPerThread()
+{
+    Debug::Indent::push();
+
+    // other threads start from scratch, and do not disturb us
+    IndentThread thread;
+    thread.start();
+    QVERIFY(thread.wait(10000));
+    QCOMPARE(thread.indent, 6);
+    QCOMPARE((int)Debug::Indent::getIndent(), 2);
+}
+
 void TestDebug::testScope()
 {
     // Not much to test here beyond that it does not crash horribly.
@@ -62,5 +108,163 @@ void TestDebug::testScope()
     }
 }
 
+void TestDebug::testScopeStack()
+{
+    QVERIFY(Debug::Scope::current() == 0);
+    QCOMPARE(Debug::Scope::stack().size(), 0);
+    {
+        Debug::Scope outer("outer");
+        QCOMPARE((int)Debug::Indent::getIndent(), 2);
+        {
+            Debug::Scope inner("inner");
+            QCOMPARE((int)Debug::Indent::getIndent(), 4);
+            QCOMPARE(QString(Debug::Scope::current()), QString("inner"));
+            QList<const char *> stack = Debug::Scope::stack();
+            QCOMPARE(stack.size(), 2);
+            QCOMPARE(QString(stack.at(0)), QString("outer"));
+            QCOMPARE(QString(stack.at(1)), QString("inner"));
+        }
+        QCOMPARE(QString(Debug::Scope::current()), QString("outer"));
+    }
+    QVERIFY(Debug::Scope::current() == 0);
+    QCOMPARE((int)Debug::Indent::getIndent(), 0);
+}
+
+void TestDebug::testProfilerEntry()
+{
+    Debug::Profiler::Entry entry;
+    entry.add(1000);
+    entry.add(3000);
+    entry.add(2000);
+    QCOMPARE(entry.count, (quint64)3);
+    QCOMPARE(entry.total, (qint64)6000);
+    QCOMPARE(entry.min, (qint64)1000);
+    QCOMPARE(entry.max, (qint64)3000);
+    QCOMPARE(entry.mean(), (qint64)2000);
+    // 1000 has 10 significant bits, 2000 and 3000 have 11 and 12
+    QCOMPARE(entry.histogram[10], (quint64)1);
+    QCOMPARE(entry.histogram[11], (quint64)1);
+    QCOMPARE(entry.histogram[12], (quint64)1);
+    // percentiles are the upper bound of their bucket, but never above the max
+    QCOMPARE(entry.percentile(0.0), (qint64)1023);
+    QCOMPARE(entry.percentile(0.5), (qint64)2047);
+    QCOMPARE(entry.percentile(0.99), (qint64)3000);
+
+    Debug::Profiler::Entry other;
+    other.add(10);
+    entry.merge(other);
+    QCOMPARE(entry.count, (quint64)4);
+    QCOMPARE(entry.min, (qint64)10);
+    QCOMPARE(entry.max, (qint64)3000);
+}
+
+void TestDebug::testProfiler()
+{
+    // scopes shall be logged by default
+    QCOMPARE(Debug::Profiler::isEnabled(), false);
+    Debug::Profiler::reset();
+    Debug::Profiler::setEnabled(true);
+
+    const char *outer = "profiled outer";
+    const char *inner = "profiled inner";
+    for(int i = 0; i < 10; i++) {
+        Debug::Scope s(outer);
+        for(int j = 0; j < 5; j++)
+            Debug::Scope t(inner);
+    }
+
+    // the outer scope contains the inner ones, so it comes first
+    QList<Debug::Profiler::Entry> report = Debug::Profiler::report();
+    QCOMPARE(report.size(), 2);
+    QVERIFY(report.at(0).identifier == outer);
+    QCOMPARE(report.at(0).count, (quint64)10);
+    QVERIFY(report.at(1).identifier == inner);
+    QCOMPARE(report.at(1).count, (quint64)50);
+    QVERIFY(report.at(0).total >= report.at(1).total);
+    QVERIFY(Debug::Profiler::formatReport().contains("profiled inner"));
+
+    Debug::Profiler::setEnabled(false);
+    Debug::Profiler::reset();
+    QCOMPARE(Debug::Profiler::report().size(), 0);
+    QVERIFY(Debug::Profiler::formatReport().isEmpty());
+}
+
+void TestDebug::testTracer()
+{
+    QString path = QDir::tempPath() + QDir::separator() + "test_debug.trace.json";
+    QCOMPARE(Debug::Tracer::isActive(), false);
+    QVERIFY(Debug::Tracer::start(path));
+    QCOMPARE(Debug::Tracer::isActive(), true);
+
+    for(int i = 0; i < 3; i++) {
+        Debug::Scope s("traced \"outer\"");
+        Debug::Scope t("traced inner");
+    }
+    Debug::Tracer::stop();
+    QCOMPARE(Debug::Tracer::isActive(), false);
+
+    QFile trace(path);
+    QVERIFY(trace.open(QIODevice::ReadOnly));
+    QByteArray json = trace.readAll();
+
+    // a complete JSON array
+    QVERIFY(json.startsWith("[\n"));
+    QVERIFY(json.endsWith("}}\n]\n"));
+    // with a beginning and an end for every scope
+    QCOMPARE(json.count("\"ph\":\"B\""), 6);
+    QCOMPARE(json.count("\"ph\":\"E\""), 6);
+    QCOMPARE(json.count("\"name\":\"traced \\\"outer\\\"\""), 6);
+    QCOMPARE(json.count("\"name\":\"traced inner\""), 6);
+    // in order
+    QVERIFY(json.indexOf("\"ph\":\"B\"") < json.indexOf("\"ph\":\"E\""));
+
+    trace.close();
+    QFile::remove(path);
+}
+
+void TestDebug::testSamplerEvery()
+{
+    Debug::Sampler sampler = LOG_SAMPLER_INITIALIZER(10, 0);
+    int admitted = 0;
+    int reported = 0;
+    int suppressed;
+    for(int i = 0; i < 100; i++) {
+        if(sampler.admit(suppressed))
+            admitted++;
+        reported += suppressed;
+    }
+    // one call in ten, starting with the first
+    QCOMPARE(admitted, 10);
+    // the first call logged starts a window, and reports nothing
+    QVERIFY(reported <= 90);
+
+    // the macro shall leave indentation alone for the calls it leaves out
+    for(int i = 0; i < 10; i++)
+        sampledFunction();
+    QCOMPARE((int)Debug::Indent::getIndent(), 0);
+}
+
+void TestDebug::testSamplerRate()
+{
+    Debug::Sampler sampler = LOG_SAMPLER_INITIALIZER(0, 5);
+    int admitted = 0;
+    int reported = 0;
+    int suppressed;
+    for(int i = 0; i < 100; i++) {
+        if(sampler.admit(suppressed))
+            admitted++;
+        reported += suppressed;
+    }
+    // five a second, and we may have crossed into the next second
+    QVERIFY(admitted >= 5 && admitted <= 10);
+
+    // the first call in a new second reports the calls left out
+    QTest::qSleep(1100);
+    QVERIFY(sampler.admit(suppressed));
+    QCOMPARE(reported + suppressed, 100 - admitted);
+    QVERIFY(sampler.admit(suppressed));
+    QCOMPARE(suppressed, 0);
+}
+
 QTEST_MAIN(TestDebug)
 #include "test_debug.moc"
@@ -40,8 +40,18 @@ private slots:
 
     void testIndentPush();
     void testIndentPop();
+    void testIndentPerThread();
 
     void testScope();
+    void testScopeStack();
+
+    void testProfilerEntry();
+    void testProfiler();
+
+    void testTracer();
+
+    void testSamplerEvery();
+    void testSamplerRate();
 
 private:
 };
@@ -0,0 +1,262 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+#include "test_logdecode.h"
+#include "log/binaryformat.h"
+#include "log/logrecord.h"
+#include "log/ringfile.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+
+#include <cstdarg>
+
+namespace {
+    /// 2011-06-01T21:04:01.123Z in ns since the epoch.
+    const qint64 T0 = Q_INT64_C(1306962241123000000);
+    const qint64 NSECS_PER_HOUR = Q_INT64_C(3600000000000);
+}
+
+QString TestLogDecode::logPath()
+{
+    return QDir::tempPath() + QDir::separator() + "test_logdecode.log";
+}
+
+QByteArray TestLogDecode::decode(const QStringList &arguments, int *exitCode)
+{
+    // the tool is built next to the library, see src/log/CMakeLists.txt
+    QString decoder = QCoreApplication::applicationDirPath() + "/../../src/log/logdecode";
+    QProcess process;
+    process.start(decoder, QStringList(arguments) << logPath());
+    if(!process.waitForFinished())
+        return QByteArray();
+    if(exitCode)
+        *exitCode = process.exitCode();
+    return process.readAllStandardOutput();
+}
+
+void TestLogDecode::writeBinary(const QList<QByteArray> &records)
+{
+    QFile file(logPath());
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    BinaryLog::FileHeader header = BinaryLog::fileHeader();
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    foreach(const QByteArray &record, records)
+        file.write(record);
+}
+
+QByteArray TestLogDecode::message(LogLevel level, qint64 time, quint64 thread, const QString &text)
+{
+    LogRecord record(level, text, 0);
+    record.time = time;
+    record.thread = thread;
+    return BinaryLog::encodeMessage(record);
+}
+
+QByteArray TestLogDecode::formatted(LogLevel level, qint64 time, quint32 formatId, const char *format, ...)
+{
+    LogRecord record(level, QString(), 2);
+    record.time = time;
+    record.thread = 1;
+    va_list ap;
+    va_start(ap, format);
+    QByteArray encoded = BinaryLog::encodeMessage(record, formatId, format, ap);
+    va_end(ap);
+    return encoded;
+}
+
+void TestLogDecode::cleanup()
+{
+    QFile::remove(logPath());
+}
+
+void TestLogDecode::testDecode()
+{
+    QList<QByteArray> records;
+    records << BinaryLog::encodeFormat(1, "value %d of %s")
+            << message(INFO, T0, 1, "plain text")
+            << formatted(DEBUG, T0 + 1000000, 1, "value %d of %s", 42, "answer")
+            << formatted(WARNING, T0 + 2000000, 2, "no definition");
+    writeBinary(records);
+
+    QStringList arguments;
+    arguments << "-z" << "-T" << "ISO_MS";
+    int exitCode = -1;
+    QCOMPARE(decode(arguments, &exitCode),
+             QByteArray("[2011-06-01T21:04:01.123Z] [INFO]     plain text\n"
+                        "[2011-06-01T21:04:01.124Z] [DEBUG]      value 42 of answer\n"
+                        "[2011-06-01T21:04:01.125Z] [WARNING]  <unknown format>\n"));
+    QCOMPARE(exitCode, 0);
+}
+
+void TestLogDecode::testLevelFilter()
+{
+    QList<QByteArray> records;
+    records << message(DEBUG, T0, 1, "debug")
+            << message(INFO, T0, 1, "info")
+            << message(WARNING, T0, 1, "warning")
+            << message(CRITICAL, T0, 1, "critical");
+    writeBinary(records);
+
+    QStringList arguments;
+    arguments << "-z" << "-T" << "EPOCH_NS" << "-l" << "WARNING";
+    QCOMPARE(decode(arguments),
+             QByteArray("[1306962241123000000] [WARNING]  warning\n"
+                        "[1306962241123000000] [CRITICAL] critical\n"));
+
+    // an unknown level is refused
+    int exitCode = -1;
+    QCOMPARE(decode(QStringList() << "-l" << "LOUD", &exitCode), QByteArray());
+    QCOMPARE(exitCode, 1);
+}
+
+void TestLogDecode::testThreadFilter()
+{
+    QList<QByteArray> records;
+    records << message(INFO, T0, 0x10, "first thread")
+            << message(INFO, T0, 0x20, "second thread")
+            << message(INFO, T0, 0x10, "first thread again");
+    writeBinary(records);
+
+    QStringList arguments;
+    arguments << "-T" << "EPOCH_NS" << "-t" << "0x20" << "-s";
+    QCOMPARE(decode(arguments), QByteArray("[1306962241123000000] [INFO]     [0x20] second thread\n"));
+}
+
+void TestLogDecode::testDamaged()
+{
+    QList<QByteArray> records;
+    records << message(INFO, T0, 1, "complete")
+            << message(INFO, T0, 1, "truncated");
+    records.last().chop(4);
+    writeBinary(records);
+
+    // what precedes the damage is still decoded
+    int exitCode = -1;
+    QStringList arguments;
+    arguments << "-T" << "EPOCH_NS";
+    QCOMPARE(decode(arguments, &exitCode), QByteArray("[1306962241123000000] [INFO]     complete\n"));
+    QCOMPARE(exitCode, 2);
+}
+
+void TestLogDecode::testRingUnwrap()
+{
+    QFile file(logPath());
+    QVERIFY(file.open(QIODevice::ReadWrite | QIODevice::Truncate));
+    RingFile ring;
+    QVERIFY(ring.open(file, 100));
+    // 29 bytes a line, so the ring wraps and only the newest lines are kept
+    for(int i = 0; i < 6; i++)
+        QVERIFY(ring.write(file, QString("[21:04:0%1] [INFO]     line %1\n").arg(i).toLatin1()));
+    file.close();
+
+    // in chronological order, without the partial line left of the oldest
+    QCOMPARE(decode(QStringList()), QByteArray("[21:04:03] [INFO]     line 3\n"
+                                               "[21:04:04] [INFO]     line 4\n"
+                                               "[21:04:05] [INFO]     line 5\n"));
+    // and filtered like any text log
+    QCOMPARE(decode(QStringList() << "-f" << "21:04:04"), QByteArray("[21:04:04] [INFO]     line 4\n"
+                                                                     "[21:04:05] [INFO]     line 5\n"));
+}
+
+void TestLogDecode::testTimeOfDayRange()
+{
+    QList<QByteArray> records;
+    records << message(INFO, T0, 1, "evening")
+            << message(INFO, T0 + 2 * NSECS_PER_HOUR, 1, "before midnight")
+            << message(INFO, T0 + 3 * NSECS_PER_HOUR, 1, "after midnight")
+            << message(INFO, T0 + 6 * NSECS_PER_HOUR, 1, "morning");
+    writeBinary(records);
+
+    // a range ending before it starts wraps past midnight
+    QStringList arguments;
+    arguments << "-z" << "-T" << "ISO_MS" << "-f" << "23:00" << "-u" << "01:00";
+    QCOMPARE(decode(arguments), QByteArray("[2011-06-01T23:04:01.123Z] [INFO]     before midnight\n"
+                                           "[2011-06-02T00:04:01.123Z] [INFO]     after midnight\n"));
+
+    // invalid times are refused
+    int exitCode = -1;
+    QCOMPARE(decode(QStringList() << "-f" << "25:00", &exitCode), QByteArray());
+    QCOMPARE(exitCode, 1);
+}
+
+void TestLogDecode::testDateRange()
+{
+    QList<QByteArray> records;
+    records << message(INFO, T0, 1, "first day")
+            << message(INFO, T0 + 24 * NSECS_PER_HOUR, 1, "second day")
+            << message(INFO, T0 + 48 * NSECS_PER_HOUR, 1, "third day");
+    writeBinary(records);
+
+    // the same time of day on different days is told apart
+    QStringList arguments;
+    arguments << "-z" << "-T" << "ISO_MS" << "-f" << "2011-06-02 00:00" << "-u" << "2011-06-03T00:00";
+    QCOMPARE(decode(arguments), QByteArray("[2011-06-02T21:04:01.123Z] [INFO]     second day\n"));
+
+    // and so it is in text logs with dates
+    QFile file(logPath());
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("[2011-06-01T21:04:01.123Z] [INFO]     first day\n"
+               "[2011-06-02T21:04:01.123Z] [INFO]     second day\n"
+               "continued\n"
+               "[2011-06-03T21:04:01.123Z] [INFO]     third day\n");
+    file.close();
+    arguments.clear();
+    arguments << "-f" << "2011-06-02 00:00" << "-u" << "2011-06-03 00:00" << "-z";
+    QCOMPARE(decode(arguments), QByteArray("[2011-06-02T21:04:01.123Z] [INFO]     second day\n"
+                                           "continued\n"));
+
+    // a date can not be compared with a time of day
+    int exitCode = -1;
+    QCOMPARE(decode(QStringList() << "-f" << "2011-06-02 00:00" << "-u" << "12:00", &exitCode), QByteArray());
+    QCOMPARE(exitCode, 1);
+}
+
+void TestLogDecode::testJsonLines()
+{
+    QFile file(logPath());
+    QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    file.write("{\"time\":\"2011-06-01T21:04:01.123Z\",\"level\":\"DEBUG\",\"thread\":1,\"indent\":0,"
+               "\"msg\":\"first day\"}\n"
+               "{\"time\":\"2011-06-02T21:04:01.123Z\",\"level\":\"WARNING\",\"thread\":1,\"indent\":0,"
+               "\"msg\":\"second day\",\"ms\":12}\n"
+               "{\"time\":\"2011-06-03T21:04:01.123Z\",\"level\":\"INFO\",\"thread\":1,\"indent\":0,"
+               "\"msg\":\"third day\"}\n");
+    file.close();
+
+    // JSON Lines are filtered by their time and level members
+    int exitCode = -1;
+    QCOMPARE(decode(QStringList() << "-l" << "INFO", &exitCode),
+             QByteArray("{\"time\":\"2011-06-02T21:04:01.123Z\",\"level\":\"WARNING\",\"thread\":1,"
+                        "\"indent\":0,\"msg\":\"second day\",\"ms\":12}\n"
+                        "{\"time\":\"2011-06-03T21:04:01.123Z\",\"level\":\"INFO\",\"thread\":1,"
+                        "\"indent\":0,\"msg\":\"third day\"}\n"));
+    QCOMPARE(exitCode, 0);
+
+    QStringList arguments;
+    arguments << "-z" << "-f" << "2011-06-02 00:00" << "-u" << "2011-06-03 00:00";
+    QCOMPARE(decode(arguments),
+             QByteArray("{\"time\":\"2011-06-02T21:04:01.123Z\",\"level\":\"WARNING\",\"thread\":1,"
+                        "\"indent\":0,\"msg\":\"second day\",\"ms\":12}\n"));
+}
+
+QTEST_MAIN(TestLogDecode)
+#include "test_logdecode.moc"
@@ -0,0 +1,64 @@
+/*
+  Logger - a simple logger for Qt-based applications.
+  Copyright (C) 2011 Bjørn Øivind Bjørnsen
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+  */
+
+#ifndef TEST_LOGDECODE_H
+#define TEST_LOGDECODE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QStringList>
+#include <QTest>
+
+#include "log/logger.h"
+
+class TestLogDecode : public QObject
+{
+    Q_OBJECT
+public:
+    TestLogDecode()
+    {
+    }
+    ~TestLogDecode() {};
+
+private slots:
+    void cleanup();
+
+    void testDecode();
+    void testLevelFilter();
+    void testThreadFilter();
+    void testDamaged();
+    void testRingUnwrap();
+    void testTimeOfDayRange();
+    void testDateRange();
+    void testJsonLines();
+
+private:
+    /// runs logdecode on the test log, and returns what it wrote.
+    QByteArray decode(const QStringList &arguments, int *exitCode = 0);
+    /// writes a binary log holding the given records.
+    void writeBinary(const QList<QByteArray> &records);
+    /// encodes a literal message.
+    static QByteArray message(LogLevel level, qint64 time, quint64 thread, const QString &text);
+    /// encodes a message with the raw arguments for a format.
+    static QByteArray formatted(LogLevel level, qint64 time, quint32 formatId, const char *format, ...);
+    /// the path of the test log.
+    static QString logPath();
+};
+
+#endif // TEST_LOGDECODE_H
@@ -20,7 +20,72 @@
 #include "test_logger.h"
 #include "common/setup.h"
 
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutex>
+#include <QRegExp>
+#include <QSettings>
 #include <QTextStream>
+#include <QThread>
+
+#include <cstring>
+
+#if defined(Q_OS_UNIX)
+#   include <csignal>
+#   include <sys/wait.h>
+#   include <unistd.h>
+#endif
+
+#include "log/binaryformat.h"
+#include "log/debug.h"
+#include "log/logcategory.h"
+#include "log/logfields.h"
+#include "log/logmetrics.h"
+#include "log/memorysink.h"
+#include "log/ringfile.h"
+#include "log/timestamp.h"
+
+LOG_CATEGORY(netCategory, "test.net");
+LOG_CATEGORY(dbCategory, "test.db");
+
+namespace {
+    /**
+      Logs through the Qt message handler and the macros from a thread of its own.
+      */
+    class HandlerThread : public QThread {
+    protected:
+        void run()
+        {
+            for(int i = 0; i < 200; i++) {
+                qWarning("message from another thread %d", i);
+                LOG_WARNING("macro message from another thread %d", i);
+                LOG_CWARNING(netCategory, "category message from another thread %d", i);
+                LOG_FIELDS(WARNING, "fields message from another thread", LogFields().add("i", i));
+            }
+        }
+    };
+
+    /**
+      A sink which holds up the thread writing to it until the gate is opened.
+      */
+    class StallingSink : public LogSink {
+    public:
+        StallingSink() : LogSink(WARNING), entered(0) {}
+
+        virtual void write(LogLevel, const QByteArray &)
+        {
+            entered = 1;
+            QMutexLocker locker(&gate);
+        }
+
+        /// locked to stall the writer.
+        QMutex gate;
+        /// set once the writer has reached the sink.
+        QAtomicInt entered;
+    };
+}
 
 void TestLogger::initTestCase()
 {
@@ -39,6 +104,12 @@ void TestLogger::init()
     Logger *log = Logger::instance();
     // make sure the log threshold is set to DEBUG
     log->setLogThreshold(DEBUG);
+    // log from the calling thread unless a test says otherwise
+    log->setAsynchronous(false);
+    log->setBufferSize(0);
+    log->setLogFormat(TEXT_FORMAT);
+    log->setLogTimeFormat(TIME_OF_DAY);
+    log->setLogTimeUtc(false);
     // set a temporary path for the test logfile
     log->setLogPath(QDir::tempPath(), "test_logger.log");
     // open the log file
@@ -73,6 +144,23 @@ void TestLogger::testClose()
     }
 }
 
+void TestLogger::testCloseWhileLogging()
+{
+    // neither the handler nor the macros shall use an instance close() has deleted
+    HandlerThread threads[2];
+    for(int i = 0; i < 2; i++)
+        threads[i].start();
+
+    while(threads[0].isRunning() || threads[1].isRunning()) {
+        Logger::instance()->close();
+        Logger::instance()->setLogToConsole(false);
+    }
+
+    for(int i = 0; i < 2; i++)
+        QVERIFY(threads[i].wait(10000));
+    QVERIFY(Logger::instance() != 0);
+}
+
 void TestLogger::testLog()
 {
     // check that the messages wind up in the log file.
@@ -130,6 +218,59 @@ void TestLogger::benchmarkLog()
     }
 }
 
+void TestLogger::testTimeFormats()
+{
+    Logger *log = Logger::instance();
+    QTextStream s(&m_logFile);
+    QString line;
+
+    // the time of day
+    QCOMPARE(log->logTimeFormat(), TIME_OF_DAY);
+    log->log(INFO, "time of day");
+    line = s.readLine();
+    QVERIFY(QRegExp("\\[\\d\\d:\\d\\d:\\d\\d\\] \\[INFO\\]     time of day").exactMatch(line));
+
+    // ISO 8601 in local time
+    log->setLogTimeFormat(ISO_MILLISECONDS);
+    QCOMPARE(log->logTimeFormat(), ISO_MILLISECONDS);
+    log->log(INFO, "milliseconds");
+    line = s.readLine();
+    QVERIFY(QRegExp("\\[\\d{4}-\\d\\d-\\d\\dT\\d\\d:\\d\\d:\\d\\d\\.\\d{3}\\] \\[INFO\\]     milliseconds").exactMatch(line));
+
+    // and in UTC
+    log->setLogTimeFormat(ISO_MICROSECONDS);
+    log->setLogTimeUtc(true);
+    QCOMPARE(log->logTimeUtc(), true);
+    log->log(INFO, "microseconds");
+    line = s.readLine();
+    QVERIFY(QRegExp("\\[\\d{4}-\\d\\d-\\d\\dT\\d\\d:\\d\\d:\\d\\d\\.\\d{6}Z\\] \\[INFO\\]     microseconds").exactMatch(line));
+
+    // the raw time
+    log->setLogTimeFormat(EPOCH_NANOSECONDS);
+    qint64 before = QDateTime::currentMSecsSinceEpoch();
+    log->log(INFO, "nanoseconds");
+    qint64 after = QDateTime::currentMSecsSinceEpoch();
+    line = s.readLine();
+    QCOMPARE(line.endsWith("] [INFO]     nanoseconds"), true);
+    qint64 time = line.mid(1, line.indexOf(']') - 1).toLongLong() / 1000000;
+    QVERIFY(time >= before - 1 && time <= after + 1);
+
+    // a known time, in UTC so the result does not depend on the time zone
+    char text[Timestamp::MAX_LENGTH + 1];
+    qint64 known = Q_INT64_C(1306962241123456789);
+    QCOMPARE(Timestamp::format(known, ISO_MICROSECONDS, true, text), 27);
+    QCOMPARE(QString(text), QString("2011-06-01T21:04:01.123456Z"));
+    Timestamp::format(known, ISO_MILLISECONDS, true, text);
+    QCOMPARE(QString(text), QString("2011-06-01T21:04:01.123Z"));
+    Timestamp::format(known, TIME_OF_DAY, true, text);
+    QCOMPARE(QString(text), QString("21:04:01"));
+    Timestamp::format(known, EPOCH_NANOSECONDS, true, text);
+    QCOMPARE(QString(text), QString("1306962241123456789"));
+    // the second is cached, make sure the fraction is not
+    Timestamp::format(known + 1000, ISO_MICROSECONDS, true, text);
+    QCOMPARE(QString(text), QString("2011-06-01T21:04:01.123457Z"));
+}
+
 void TestLogger::testLogThreshold()
 {
     // test checking log threshold, check that the contents of the log file
@@ -165,6 +306,116 @@ void TestLogger::testLogThreshold()
     log->setLogThreshold(DEBUG);
 }
 
+void TestLogger::testLogMacros()
+{
+    Logger *log = Logger::instance();
+    QTextStream s(&m_logFile);
+    QString line;
+    int evaluated = 0;
+
+    LOG_DEBUG("debug macro %d", ++evaluated);
+    line = s.readLine();
+    QCOMPARE(line.endsWith("[DEBUG]    debug macro 1"), true);
+
+    // disabled levels shall not evaluate their arguments, nor log anything.
+    log->setLogThreshold(WARNING);
+    QCOMPARE(Logger::isEnabled(INFO), false);
+    QCOMPARE(Logger::isEnabled(WARNING), true);
+    qint64 size = m_logFile.size();
+    LOG_DEBUG("debug macro %d", ++evaluated);
+    LOG_INFO("info macro %d", ++evaluated);
+    QCOMPARE(evaluated, 1);
+    QCOMPARE(m_logFile.size(), size);
+
+    LOG_WARNING("warning macro %s", "text");
+    line = s.readLine();
+    QCOMPARE(line.endsWith("[WARNING]  warning macro text"), true);
+
+    LOG_CRITICAL("critical macro");
+    line = s.readLine();
+    QCOMPARE(line.endsWith("[CRITICAL] critical macro"), true);
+
+    // reset log threshold
+    log->setLogThreshold(DEBUG);
+}
+
+void TestLogger::testCategories()
+{
+    Logger *log = Logger::instance();
+    log->setLogThreshold(WARNING);
+    // categories shall follow the log threshold by default
+    QCOMPARE(log->categoryThreshold("test.net"), WARNING);
+    QCOMPARE(netCategory.isEnabled(DEBUG), false);
+    QCOMPARE(netCategory.isEnabled(WARNING), true);
+    QVERIFY(LogCategory::names().contains("test.net"));
+
+    log->setCategoryThreshold("test.net", DEBUG);
+    QCOMPARE(log->categoryThreshold("test.net"), DEBUG);
+    QCOMPARE(netCategory.isEnabled(DEBUG), true);
+    QCOMPARE(dbCategory.isEnabled(DEBUG), false);
+    QCOMPARE(Logger::isEnabled(DEBUG), false);
+
+    LOG_CDEBUG(netCategory, "connected to %s", "host");
+    LOG_CDEBUG(dbCategory, "query");
+    LOG_DEBUG("uncategorised");
+    log->log(dbCategory, WARNING, "db warning");
+
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("test.net: connected to host"), true);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  test.db: db warning"), true);
+    QVERIFY(s.atEnd());
+
+    // the log threshold shall not affect a category with a threshold of its own
+    log->setLogThreshold(NONE);
+    QCOMPARE(netCategory.isEnabled(DEBUG), true);
+    QCOMPARE(dbCategory.isEnabled(CRITICAL), false);
+
+    log->clearCategoryThreshold("test.net");
+    QCOMPARE(log->categoryThreshold("test.net"), NONE);
+    QCOMPARE(netCategory.isEnabled(CRITICAL), false);
+}
+
+void TestLogger::testReloadSettings()
+{
+    Logger *log = Logger::instance();
+    QSettings settings;
+    settings.setValue("Log/log_threshold", "CRITICAL");
+    settings.setValue("Log/log_time_utc", true);
+    settings.setValue("Log/log_category/test.reload", "DEBUG");
+    settings.sync();
+
+    // nothing shall change until the settings are reloaded
+    QCOMPARE(log->logThreshold(), DEBUG);
+    log->reloadSettings();
+    QCOMPARE(log->logThreshold(), CRITICAL);
+    QCOMPARE(log->logTimeUtc(), true);
+    QCOMPARE(log->categoryThreshold("test.reload"), DEBUG);
+
+    // the log file shall not have been reopened, which truncates it
+    log->log(CRITICAL, "before reload");
+    log->reloadSettings();
+    log->log(CRITICAL, "after reload");
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("before reload"), true);
+    QCOMPARE(s.readLine().endsWith("after reload"), true);
+
+    // the settings shall not be watched by default
+    QCOMPARE(log->watchSettings(), false);
+    log->setWatchSettings(true);
+    QCOMPARE(log->watchSettings(), true);
+
+    settings.setValue("Log/log_threshold", "INFO");
+    settings.remove("Log/log_category/test.reload");
+    settings.sync();
+    for(int i = 0; i < 50 && log->logThreshold() != INFO; i++)
+        QTest::qWait(100);
+    QCOMPARE(log->logThreshold(), INFO);
+    QCOMPARE(log->categoryThreshold("test.reload"), INFO);
+
+    log->setWatchSettings(false);
+    QCOMPARE(log->watchSettings(), false);
+}
+
 void TestLogger::testLogToConsole()
 {
     Logger *log = Logger::instance();
@@ -174,6 +425,25 @@ void TestLogger::testLogToConsole()
     QCOMPARE(log->logToConsole(), false);
     log->setLogToConsole(true);
     QCOMPARE(log->logToConsole(), true);
+
+#if defined(Q_OS_UNIX)
+    // the console output shall be written to standard error
+    QFile console(m_logFile.fileName() + ".console");
+    QVERIFY(console.open(QIODevice::ReadWrite | QIODevice::Truncate));
+    int saved = dup(STDERR_FILENO);
+    dup2(console.handle(), STDERR_FILENO);
+    log->log(WARNING, QString::fromUtf8("console message \xc3\xa6"));
+    log->log(CRITICAL, "console message 2");
+    dup2(saved, STDERR_FILENO);
+    close(saved);
+
+    // the descriptors shared the offset, which is now at the end
+    QVERIFY(console.seek(0));
+    QByteArray output = console.readAll();
+    QVERIFY(output.contains("[WARNING]  console message \xc3\xa6"));
+    QVERIFY(output.contains("[CRITICAL] console message 2"));
+    console.remove();
+#endif
 }
 
 void TestLogger::testLogLimit()
@@ -209,5 +479,614 @@ void TestLogger::testLogLimit()
     QVERIFY(m_logFile.size() < size);
 }
 
+void TestLogger::testRotation()
+{
+    Logger *log = Logger::instance();
+    // there shall be no rotation by default
+    QCOMPARE(log->logMaxSize(), qint64(0));
+    QCOMPARE(log->logGenerations(), 5);
+    log->setLogMaxSize(256);
+    log->setLogGenerations(2);
+    QCOMPARE(log->logMaxSize(), qint64(256));
+    QCOMPARE(log->logGenerations(), 2);
+
+    // a file left over from an earlier rotation shall never be overwritten
+    QString path = QDir::tempPath() + QDir::separator() + "test_logger.log";
+    QFile leftover(QString("%1.%2-1.rotated").arg(path).arg(QCoreApplication::applicationPid()));
+    QVERIFY(leftover.open(QIODevice::WriteOnly | QIODevice::Truncate));
+    leftover.write("leftover");
+    leftover.close();
+
+    // about 45 bytes per line, so this rotates several times
+    for(int i = 0; i < 40; i++)
+        log->log(INFO, QString("rotating message %1").arg(i));
+
+    // the current file shall never grow past the limit
+    QVERIFY(QFileInfo(path).size() <= 256);
+
+    // closing waits for the compression to finish
+    log->setLogMaxSize(0);
+    log->setLogGenerations(5);
+    log->close();
+
+    // we shall have kept exactly two compressed generations
+    QFile first(path + ".1.gz");
+    QVERIFY(first.exists());
+    QVERIFY(QFile::exists(path + ".2.gz"));
+    QVERIFY(!QFile::exists(path + ".3.gz"));
+    QVERIFY(first.open(QIODevice::ReadOnly));
+    QCOMPARE(first.read(2), QByteArray("\x1f\x8b"));
+    first.close();
+
+    QVERIFY(leftover.open(QIODevice::ReadOnly));
+    QCOMPARE(leftover.readAll(), QByteArray("leftover"));
+    leftover.close();
+
+    QFile::remove(path + ".1.gz");
+    QFile::remove(path + ".2.gz");
+    leftover.remove();
+}
+
+void TestLogger::testRingFile()
+{
+    Logger *log = Logger::instance();
+    // the logfile shall not be a ring by default
+    QCOMPARE(log->logRingSize(), qint64(0));
+    log->setLogRingSize(128);
+    QCOMPARE(log->logRingSize(), qint64(128));
+
+    // the file shall be allocated up front
+    QString path = QDir::tempPath() + QDir::separator() + "test_logger.log";
+    qint64 size = sizeof(RingFile::Header) + 128;
+    QCOMPARE(QFileInfo(path).size(), size);
+
+    // about 35 bytes per line, so this wraps several times
+    for(int i = 0; i < 20; i++)
+        log->log(INFO, QString("ring message %1").arg(i));
+
+    // and never grow
+    QCOMPARE(QFileInfo(path).size(), size);
+
+    QByteArray data = m_logFile.readAll();
+    QVERIFY(RingFile::isRing(data.constData(), data.size()));
+    QList<QByteArray> lines = RingFile::unwrap(data.constData(), data.size()).split('\n');
+    // the last line is empty, as the output ends with a newline
+    QCOMPARE(lines.last(), QByteArray());
+    lines.removeLast();
+    QVERIFY(lines.size() >= 2);
+    QVERIFY(lines.last().endsWith("[INFO]     ring message 19"));
+    // only whole lines, in order
+    QVERIFY(lines.at(lines.size() - 2).endsWith("[INFO]     ring message 18"));
+    QVERIFY(lines.first().startsWith("["));
+
+    // a restart shall continue the ring rather than start over
+    log->close();
+    log = Logger::instance();
+    log->log(INFO, "after restart");
+    m_logFile.seek(0);
+    data = m_logFile.readAll();
+    QByteArray text = RingFile::unwrap(data.constData(), data.size());
+    QVERIFY(text.contains("[INFO]     ring message 19\n"));
+    QVERIFY(text.endsWith("[INFO]     after restart\n"));
+
+    log->setLogRingSize(0);
+}
+
+void TestLogger::testMappedFile()
+{
+    Logger *log = Logger::instance();
+    // the logfile shall not be mapped by default
+    QCOMPARE(log->logMapped(), false);
+    log->setLogMapped(true);
+    QCOMPARE(log->logMapped(), true);
+
+    for(int i = 0; i < 10; i++)
+        log->log(INFO, QString("mapped message %1").arg(i));
+
+    // the output shall be readable straight away
+    QTextStream s(&m_logFile);
+    QString line;
+    for(int i = 0; i < 10; i++) {
+        line = s.readLine();
+        QCOMPARE(line.endsWith(QString("[INFO]     mapped message %1").arg(i)), true);
+    }
+
+    // while the file has been extended by a whole chunk
+    QString path = QDir::tempPath() + QDir::separator() + "test_logger.log";
+    QVERIFY(QFileInfo(path).size() > s.pos());
+
+    // truncating shall not leave the old output behind in the mapping
+    log->setLogLimit(10);
+    log->log(INFO, "after truncation");
+    m_logFile.seek(0);
+    QByteArray content = m_logFile.readAll();
+    QVERIFY(content.contains("after truncation"));
+    QVERIFY(!content.contains("mapped message"));
+
+    // closing shall trim the file to the output written
+    qint64 size = content.indexOf('\n') + 1;
+    log->setLogLimit(0);
+    log->close();
+    QCOMPARE(QFileInfo(path).size(), size);
+
+    Logger::instance()->setLogMapped(false);
+}
+
+void TestLogger::testAsynchronous()
+{
+    Logger *log = Logger::instance();
+    // logging shall be synchronous by default
+    QCOMPARE(log->asynchronous(), false);
+    log->setAsynchronous(true);
+    QCOMPARE(log->asynchronous(), true);
+
+    for(int i = 0; i < 100; i++)
+        log->log(INFO, QString("async message %1").arg(i));
+
+    // disabling asynchronous mode shall write out everything still queued.
+    log->setAsynchronous(false);
+    QCOMPARE(log->asynchronous(), false);
+
+    // check that every message arrived, in order.
+    QTextStream s(&m_logFile);
+    QString line;
+    for(int i = 0; i < 100; i++) {
+        line = s.readLine();
+        QCOMPARE(line.endsWith(QString("[INFO]     async message %1").arg(i)), true);
+    }
+
+    // switching modes while another thread logs shall lose nothing.
+    HandlerThread thread;
+    thread.start();
+    for(int i = 0; i < 20; i++)
+        log->setAsynchronous(i % 2 == 0);
+    thread.wait();
+    log->setAsynchronous(false);
+    int messages = 0;
+    while(!s.atEnd()) {
+        if(s.readLine().contains("message from another thread"))
+            ++messages;
+    }
+    QCOMPARE(messages, 200);
+}
+
+void TestLogger::testOverflowPolicy()
+{
+    // a small queue, which a stalled writer fills quickly
+    QSettings settings;
+    settings.setValue("Log/log_queue_size", 4);
+    Logger::instance()->close();
+    Logger *log = Logger::instance();
+    // callers shall wait for room by default
+    QCOMPARE(log->overflowPolicy(), OVERFLOW_BLOCK);
+    log->setOverflowPolicy(OVERFLOW_DROP_BELOW_WARNING);
+    QCOMPARE(log->overflowPolicy(), OVERFLOW_DROP_BELOW_WARNING);
+    log->setAsynchronous(true);
+
+    StallingSink sink;
+    sink.gate.lock();
+    log->addSink(&sink);
+    log->log(WARNING, "stalling message");
+    while(sink.entered == 0)
+        QThread::yieldCurrentThread();
+
+    // fill the queue, then overflow it
+    for(int i = 0; i < 4; i++)
+        log->log(INFO, QString("queued message %1").arg(i));
+    log->log(DEBUG, "dropped message 1");
+    log->log(INFO, "dropped message 2");
+    log->log(INFO, "dropped message 3");
+    QCOMPARE(log->droppedMessages(DEBUG), qint64(1));
+    QCOMPARE(log->droppedMessages(INFO), qint64(2));
+    QCOMPARE(log->droppedMessages(WARNING), qint64(0));
+
+    sink.gate.unlock();
+    log->setAsynchronous(false);
+    log->removeSink(&sink);
+    // the counts shall outlive the writer
+    QCOMPARE(log->droppedMessages(INFO), qint64(2));
+
+    // the drops shall be reported after what was queued
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  stalling message"), true);
+    for(int i = 0; i < 4; i++)
+        QCOMPARE(s.readLine().endsWith(QString("[INFO]     queued message %1").arg(i)), true);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  3 messages dropped while the log writer was behind "
+                                   "(DEBUG: 1, INFO: 2, WARNING: 0, CRITICAL: 0)."), true);
+
+    // the report shall not be hidden by the threshold of the log file
+    log->setLogThreshold(CRITICAL);
+    log->setOverflowPolicy(OVERFLOW_DROP_NEWEST);
+    log->setAsynchronous(true);
+    StallingSink stalling;
+    stalling.gate.lock();
+    log->addSink(&stalling);
+    log->log(WARNING, "stalling message");
+    while(stalling.entered == 0)
+        QThread::yieldCurrentThread();
+    for(int i = 0; i < 5; i++)
+        log->log(WARNING, QString("sink message %1").arg(i));
+    stalling.gate.unlock();
+    log->setAsynchronous(false);
+    log->removeSink(&stalling);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  1 messages dropped while the log writer was behind "
+                                   "(DEBUG: 0, INFO: 0, WARNING: 1, CRITICAL: 0)."), true);
+    QVERIFY(s.atEnd());
+
+    log->setOverflowPolicy(OVERFLOW_BLOCK);
+    settings.remove("Log/log_queue_size");
+}
+
+void TestLogger::testBuffering()
+{
+    Logger *log = Logger::instance();
+    // output shall not be buffered by default
+    QCOMPARE(log->bufferSize(), 0);
+    log->setBufferSize(4096);
+    QCOMPARE(log->bufferSize(), 4096);
+    log->setFlushInterval(60000);
+    QCOMPARE(log->flushInterval(), 60000);
+
+    qint64 size = m_logFile.size();
+    for(int i = 0; i < 10; i++)
+        log->log(INFO, QString("buffered message %1").arg(i));
+
+    // nothing shall have reached the file before the buffer is flushed.
+    QCOMPARE(m_logFile.size(), size);
+
+    log->flush();
+
+    // check that every message arrived, in order.
+    QTextStream s(&m_logFile);
+    QString line;
+    for(int i = 0; i < 10; i++) {
+        line = s.readLine();
+        QCOMPARE(line.endsWith(QString("[INFO]     buffered message %1").arg(i)), true);
+    }
+
+    // the output of a thread which stops logging shall not wait for its next message.
+    log->setFlushInterval(50);
+    size = m_logFile.size();
+    log->log(INFO, "idle message");
+    for(int i = 0; i < 50 && m_logFile.size() == size; i++)
+        QTest::qSleep(20);
+    QCOMPARE(s.readLine().endsWith("[INFO]     idle message"), true);
+
+    log->setFlushInterval(1000);
+    log->setBufferSize(0);
+}
+
+void TestLogger::testCrashHandler()
+{
+#if defined(Q_OS_UNIX)
+    Logger *log = Logger::instance();
+    // the crash handler shall not be installed by default
+    QCOMPARE(log->crashHandler(), false);
+    log->setCrashHandler(true);
+    QCOMPARE(log->crashHandler(), true);
+    log->setBufferSize(4096);
+    log->setFlushInterval(60000);
+
+    // crash a copy of ourselves with output still buffered
+    pid_t pid = fork();
+    if(pid == 0) {
+        log->log(INFO, "last words");
+        raise(SIGSEGV);
+        _exit(0);
+    }
+    QVERIFY(pid > 0);
+    int status = 0;
+    QCOMPARE(waitpid(pid, &status, 0), pid);
+    QVERIFY(WIFSIGNALED(status));
+    QCOMPARE(WTERMSIG(status), SIGSEGV);
+
+    // the buffered message shall have been saved by the handler
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[INFO]     last words"), true);
+
+    log->setCrashHandler(false);
+    QCOMPARE(log->crashHandler(), false);
+    log->setFlushInterval(1000);
+    log->setBufferSize(0);
+#endif
+}
+
+void TestLogger::testRepeatCollapsing()
+{
+    Logger *log = Logger::instance();
+    // repeated messages shall be written by default
+    QCOMPARE(log->repeatInterval(), 0);
+    log->setRepeatInterval(60000);
+    QCOMPARE(log->repeatInterval(), 60000);
+
+    for(int i = 0; i < 5; i++)
+        log->log(INFO, "repeated message");
+    for(int i = 0; i < 3; i++)
+        LOG_WARNING("repeated %s", "warning");
+    log->log(INFO, "repeated message");
+    log->log(INFO, "repeated message");
+    log->flush();
+
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[INFO]     repeated message"), true);
+    QCOMPARE(s.readLine().endsWith("[INFO]     Last message repeated 4 times."), true);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  repeated warning"), true);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  Last message repeated 2 times."), true);
+    QCOMPARE(s.readLine().endsWith("[INFO]     repeated message"), true);
+    QCOMPARE(s.readLine().endsWith("[INFO]     Last message repeated once."), true);
+    QVERIFY(s.atEnd());
+
+    // repeats shall be reported once held back for the interval, without another message.
+    log->setRepeatInterval(50);
+    for(int i = 0; i < 3; i++)
+        log->log(INFO, "stormy message");
+    qint64 size = m_logFile.size();
+    for(int i = 0; i < 50 && m_logFile.size() == size; i++)
+        QTest::qSleep(20);
+    QCOMPARE(s.readLine().endsWith("[INFO]     stormy message"), true);
+    QCOMPARE(s.readLine().endsWith("[INFO]     Last message repeated 2 times."), true);
+
+    log->setRepeatInterval(0);
+}
+
+void TestLogger::testSinks()
+{
+    Logger *log = Logger::instance();
+    log->setLogThreshold(WARNING);
+    QCOMPARE(Logger::isEnabled(INFO), false);
+
+    // keep DEBUG in memory while only WARNING and above go to the file
+    MemorySink memory(3, DEBUG);
+    MemorySink binary(10, WARNING, BINARY_FORMAT);
+    log->addSink(&memory);
+    log->addSink(&binary);
+    QCOMPARE(log->sinks().size(), 2);
+    QCOMPARE(Logger::isEnabled(DEBUG), true);
+
+    LOG_DEBUG("sink message %d", 1);
+    LOG_INFO("sink message %d", 2);
+    log->log(WARNING, "sink message 3");
+    log->log(DEBUG, "sink message 4");
+
+    // the file shall only have the warning
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  sink message 3"), true);
+    QVERIFY(s.atEnd());
+
+    // the memory sink shall have the newest three messages
+    QList<QByteArray> messages = memory.messages();
+    QCOMPARE(messages.size(), 3);
+    QCOMPARE(messages.at(0).endsWith("[INFO]     sink message 2\n"), true);
+    QCOMPARE(messages.at(1).endsWith("[WARNING]  sink message 3\n"), true);
+    QCOMPARE(messages.at(2).endsWith("sink message 4\n"), true);
+
+    // and the binary sink only the warning, as a message record
+    QCOMPARE(binary.messages().size(), 1);
+    QVERIFY(binary.messages().at(0).endsWith("sink message 3"));
+
+    // raising the threshold of the sinks shall filter before formatting
+    memory.setThreshold(CRITICAL);
+    QCOMPARE(Logger::isEnabled(DEBUG), false);
+    QCOMPARE(Logger::isEnabled(WARNING), true);
+
+    log->removeSink(&memory);
+    log->removeSink(&binary);
+    QCOMPARE(log->sinks().size(), 0);
+    log->log(WARNING, "sink message 5");
+    QCOMPARE(binary.messages().size(), 1);
+}
+
+void TestLogger::testFlightRecorder()
+{
+    Logger *log = Logger::instance();
+    log->setLogThreshold(WARNING);
+    // there shall be no flight recorder by default
+    QCOMPARE(log->flightRecorderSize(), 0);
+    QCOMPARE(Logger::isEnabled(DEBUG), false);
+    log->setFlightRecorderSize(3);
+    QCOMPARE(log->flightRecorderSize(), 3);
+    QCOMPARE(Logger::isEnabled(DEBUG), true);
+
+    for(int i = 0; i < 5; i++)
+        log->log(DEBUG, QString("context %1").arg(i));
+    log->log(INFO, "info context");
+    log->log(WARNING, "warning message");
+
+    // only the warning shall have been written so far
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  warning message"), true);
+    QVERIFY(s.atEnd());
+
+    // the newest three messages shall be written before the critical one
+    log->log(CRITICAL, "critical message");
+    QCOMPARE(s.readLine().endsWith("Flight recorder: the last 3 messages below the threshold follow."), true);
+    QCOMPARE(s.readLine().endsWith("context 3"), true);
+    QCOMPARE(s.readLine().endsWith("context 4"), true);
+    QCOMPARE(s.readLine().endsWith("[INFO]     info context"), true);
+    QCOMPARE(s.readLine().endsWith("Flight recorder: end."), true);
+    QCOMPARE(s.readLine().endsWith("[CRITICAL] critical message"), true);
+
+    // and only once
+    log->log(CRITICAL, "critical message 2");
+    QCOMPARE(s.readLine().endsWith("[CRITICAL] critical message 2"), true);
+    QVERIFY(s.atEnd());
+
+    // what was queued before the context shall be written before it
+    log->setAsynchronous(true);
+    log->log(WARNING, "queued warning");
+    log->log(DEBUG, "async context");
+    log->log(CRITICAL, "critical message 3");
+    log->flush();
+    QCOMPARE(s.readLine().endsWith("[WARNING]  queued warning"), true);
+    QCOMPARE(s.readLine().endsWith("Flight recorder: the last 1 messages below the threshold follow."), true);
+    QCOMPARE(s.readLine().endsWith("async context"), true);
+    QCOMPARE(s.readLine().endsWith("Flight recorder: end."), true);
+    QCOMPARE(s.readLine().endsWith("[CRITICAL] critical message 3"), true);
+    log->setAsynchronous(false);
+
+    log->setFlightRecorderSize(0);
+    QCOMPARE(Logger::isEnabled(DEBUG), false);
+}
+
+void TestLogger::testMetrics()
+{
+    Logger *log = Logger::instance();
+    log->setLogThreshold(INFO);
+    LogMetrics before = log->metrics();
+    qint64 size = m_logFile.size();
+
+    log->log(DEBUG, "filtered message");
+    log->log(INFO, "accepted message");
+    log->log(WARNING, "accepted message");
+
+    // messages shall be counted by level, and every byte written
+    LogMetrics metrics = log->metrics();
+    QCOMPARE(metrics.filtered[DEBUG] - before.filtered[DEBUG], qint64(1));
+    QCOMPARE(metrics.accepted[INFO] - before.accepted[INFO], qint64(1));
+    QCOMPARE(metrics.accepted[WARNING] - before.accepted[WARNING], qint64(1));
+    QCOMPARE(metrics.bytesWritten - before.bytesWritten, m_logFile.size() - size);
+    qint64 writes = 0;
+    for(int i = 0; i < LogMetrics::LATENCY_BUCKETS; i++)
+        writes += metrics.writeLatency[i] - before.writeLatency[i];
+    QCOMPARE(writes, qint64(2));
+
+    // the buckets shall double from a microsecond up
+    QCOMPARE(LogMetrics::bucket(999), 0);
+    QCOMPARE(LogMetrics::bucket(1500), 1);
+    QCOMPARE(LogMetrics::bucketLimit(3), qint64(8000));
+    LogMetrics histogram;
+    histogram.flushLatency[0] = 99;
+    histogram.flushLatency[3] = 1;
+    QCOMPARE(LogMetrics::percentile(histogram.flushLatency, 50), qint64(1000));
+    QCOMPARE(LogMetrics::percentile(histogram.flushLatency, 100), qint64(8000));
+
+    // statistics shall be written along with the output, when asked for
+    QCOMPARE(log->statisticsInterval(), 0);
+    log->setStatisticsInterval(1);
+    QCOMPARE(log->statisticsInterval(), 1);
+    QTest::qSleep(5);
+    log->log(INFO, "statistics trigger");
+    log->setStatisticsInterval(0);
+
+    QByteArray contents = m_logFile.readAll();
+    QVERIFY(contents.contains("[INFO]     Logger statistics: accepted "));
+    QVERIFY(contents.contains(" bytes written; "));
+}
+
+void TestLogger::testBinaryFormat()
+{
+    Logger *log = Logger::instance();
+    // the log file shall be written as text by default
+    QCOMPARE(log->logFormat(), TEXT_FORMAT);
+    log->setLogToConsole(false);
+    log->setLogFormat(BINARY_FORMAT);
+    QCOMPARE(log->logFormat(), BINARY_FORMAT);
+
+    LOG_INFO("binary message %d", 42);
+    log->log(WARNING, "literal message");
+
+    // the file shall start with a valid header
+    QByteArray data = m_logFile.readAll();
+    QVERIFY(BinaryLog::isValid(data.constData(), data.size()));
+    int offset = sizeof(BinaryLog::FileHeader);
+
+    // followed by, at least, the definition of our format and two messages
+    QByteArray format;
+    QByteArray message;
+    QByteArray literal;
+    BinaryLog::RecordHeader header;
+    while(offset + int(sizeof(header)) <= data.size()) {
+        memcpy(&header, data.constData() + offset, sizeof(header));
+        QVERIFY(header.size >= sizeof(header));
+        QByteArray payload = data.mid(offset + sizeof(header), header.size - sizeof(header));
+        if(header.type == BinaryLog::FormatRecord && payload == "binary message %d")
+            format = payload;
+        else if(header.type == BinaryLog::MessageRecord && header.formatId && header.level == INFO)
+            message = BinaryLog::formatArguments(format.constData(), payload.constData(), payload.size());
+        else if(header.type == BinaryLog::MessageRecord && header.level == WARNING)
+            literal = payload;
+        offset += header.size;
+    }
+    QCOMPARE(offset, data.size());
+    QCOMPARE(format, QByteArray("binary message %d"));
+    QCOMPARE(message, QByteArray("binary message 42"));
+    QCOMPARE(literal, QByteArray("literal message"));
+
+    log->setLogFormat(TEXT_FORMAT);
+    log->setLogToConsole(true);
+}
+
+void TestLogger::testJsonFormat()
+{
+    Logger *log = Logger::instance();
+    log->setLogToConsole(false);
+    log->setLogFormat(JSON_FORMAT);
+    QCOMPARE(log->logFormat(), JSON_FORMAT);
+    MemorySink text(2, WARNING);
+    log->addSink(&text);
+
+    LOG_FIELDS(WARNING, "request \"served\"", LogFields().add("path", "/index.html").add("status", 200)
+               .add("ms", 1.5).add("cached", false).add("user", QString::fromUtf8("bj\xc3\xb8rn")));
+    log->log(WARNING, "plain\tmessage");
+    log->removeSink(&text);
+
+    // every message shall be a line holding an object, fields included
+    QByteArray line = m_logFile.readLine();
+    QVERIFY(line.startsWith("{\"time\":\""));
+    QVERIFY(line.contains(",\"level\":\"WARNING\",\"thread\":"));
+    QVERIFY(line.contains(",\"indent\":0,"));
+    QVERIFY(line.endsWith(",\"msg\":\"request \\\"served\\\"\",\"path\":\"/index.html\",\"status\":200,"
+                          "\"ms\":1.5,\"cached\":false,\"user\":\"bj\xc3\xb8rn\"}\n"));
+    line = m_logFile.readLine();
+    QVERIFY(line.endsWith(",\"msg\":\"plain\\tmessage\"}\n"));
+    QVERIFY(m_logFile.atEnd());
+
+    // a text sink shall get the fields after the message
+    QVERIFY(text.messages().at(0).contains("request \"served\" {\"path\":\"/index.html\",\"status\":200,"));
+    QVERIFY(text.messages().at(1).endsWith("plain\tmessage\n"));
+
+    // without sinks the line is rendered straight from the text and fields
+    LOG_FIELDS(WARNING, "direct \"line\"", LogFields().add("status", 404));
+    line = m_logFile.readLine();
+    QVERIFY(line.startsWith("{\"time\":\""));
+    QVERIFY(line.contains(",\"level\":\"WARNING\",\"thread\":"));
+    QVERIFY(line.endsWith(",\"msg\":\"direct \\\"line\\\"\",\"status\":404}\n"));
+    QVERIFY(m_logFile.atEnd());
+
+    log->setLogFormat(TEXT_FORMAT);
+    log->setLogToConsole(true);
+
+    LOG_FIELDS(WARNING, "text message", LogFields().add("id", qint64(-42)));
+    QTextStream s(&m_logFile);
+    QCOMPARE(s.readLine().endsWith("[WARNING]  text message {\"id\":-42}"), true);
+
+    // long integers, such as a time_t or a size_t, are fields too
+    LOG_FIELDS(WARNING, "long fields", LogFields().add("when", long(-7)).add("length", strlen("four")));
+    QCOMPARE(s.readLine().endsWith("[WARNING]  long fields {\"when\":-7,\"length\":4}"), true);
+}
+
+void TestLogger::testProfile()
+{
+    Logger *log = Logger::instance();
+    // scopes shall be logged by default
+    QCOMPARE(log->logProfile(), false);
+    log->setLogProfile(true);
+    QCOMPARE(log->logProfile(), true);
+
+    for(int i = 0; i < 3; i++)
+        Debug::Scope scope("profiled scope");
+
+    // nothing shall be logged until the Logger is closed
+    QCOMPARE(m_logFile.size(), (qint64)0);
+    log->close();
+
+    QByteArray data = m_logFile.readAll();
+    QVERIFY(data.contains("Profile:"));
+    QVERIFY(data.contains("profiled scope"));
+    QVERIFY(!data.contains("Entering"));
+
+    Logger::instance()->setLogProfile(false);
+}
+
 QTEST_MAIN(TestLogger)
 #include "test_logger.moc"
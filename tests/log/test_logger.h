@@ -42,15 +42,38 @@ private slots:
 
     void testInstance();
     void testClose();
+    void testCloseWhileLogging();
 
     void testLog();
     void benchmarkLog();
+    void testTimeFormats();
 
     void testLogThreshold();
+    void testLogMacros();
+    void testCategories();
+    void testReloadSettings();
 
     void testLogToConsole();
 
     void testLogLimit();
+    void testRotation();
+    void testRingFile();
+    void testMappedFile();
+
+    void testAsynchronous();
+    void testOverflowPolicy();
+
+    void testBuffering();
+    void testCrashHandler();
+    void testRepeatCollapsing();
+    void testSinks();
+    void testFlightRecorder();
+    void testMetrics();
+
+    void testBinaryFormat();
+    void testJsonFormat();
+
+    void testProfile();
 
 private:
     QFile m_logFile;